@@ -0,0 +1,593 @@
+// BinnedBDT: boosted decision trees trained on variables binned once into nCuts+1 levels
+//
+// Each variable of the training events is binned once, at the nCuts quantiles of
+// its values, into a byte code. A node is then split by accumulating, for every
+// variable, the histogram of its events over the codes, and taking the best of the
+// nCuts cuts between codes from the cumulative sums. Only the smaller child of a
+// split is histogrammed again: the histogram of its sibling is that of the parent
+// minus its own. The cost of a tree is thus one pass over the events per level,
+// instead of one per candidate cut.
+//
+// The options are those of the TMVA BDT method (unknown ones are ignored):
+//
+//    NTrees, MaxDepth, nCuts, nEventsMin, NNodesMax,
+//    BoostType=AdaBoost|Grad, AdaBoostBeta, UseYesNoLeaf,
+//    SeparationType=GiniIndex|CrossEntropy|MisClassificationError (AdaBoost),
+//    Shrinkage, UseBaggedGrad, GradBaggingFraction (Grad)
+//
+// and the response is that of TMVA, in [-1,1]: the boost weighted mean of the
+// leaf values for AdaBoost, 2/(1+exp(-2F))-1 of the sum F of the trees for Grad.
+// Unlike TMVA, the cuts are fixed for the whole training instead of spread over
+// the range of each node.
+//
+//    BinnedBDT bdt( "NTrees=400:MaxDepth=3:BoostType=AdaBoost:nCuts=20" );
+//    bdt.Train( caches, isSignal, branches, EventCache::kTrainable );
+//    BinnedBDTEvaluator evaluator( backgroundBranches, signalBranches );
+//    evaluator.AddForest( &bdt, 0, 0.5, 0.5 );   // scans[0] holds (response+1)/2
+//    evaluation.Run( evaluator, scans );
+
+#ifndef BinnedBDT__def
+#define BinnedBDT__def
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+
+#include "TTree.h"
+#include "TString.h"
+
+#include "EventCache.h"
+#include "ParallelEvaluation.h"
+#include "SignificanceScan.h"
+
+class BinnedBDT {
+
+ public:
+
+   enum EBoostType { kAdaBoost, kGrad };
+   enum ESeparation { kGiniIndex, kCrossEntropy, kMisClassificationError };
+
+   BinnedBDT( const TString& options );
+
+   // train on the training events of the samples passing "selection", of about
+   // the fraction "fraction" of them (see EventCache::AddToFactory); false if a
+   // branch is not cached or a class has no events
+   bool Train( const std::vector<const EventCache*>& samples, const std::vector<bool>& isSignal,
+               const std::vector<TString>& branches, EventCache::ESelection selection = EventCache::kTrainable,
+               double fraction = 1 );
+
+   // response to the values of the branches given to Train, in their order
+   double GetResponse( const Float_t* values ) const;
+
+   size_t GetNTrees() const { return fRoots.size(); }
+   size_t GetNVariables() const { return fEdges.size(); }
+
+ private:
+
+   // a leaf has fVariable -1; the children of a node are fLeft and fLeft+1
+   struct Node {
+      int           fVariable;
+      unsigned char fCut;        // codes <= fCut go left
+      int           fLeft;
+      double        fValue;
+   };
+
+   // per event and code: the statistics the splits are taken from, for AdaBoost
+   // the signal and background weight, for Grad the weighted residual, the weight
+   // and the weighted r(1-r) of the leaf value; and the number of events
+   enum { kNStats = 4 };
+
+   void   SetOption( const std::string& key, const std::string& value );
+   void   Bin( const std::vector<std::vector<Float_t> >& values );
+   void   Build( int inode, size_t begin, size_t end, int depth, const std::vector<double>& hist );
+   void   Histogram( size_t begin, size_t end, std::vector<double>& hist ) const;
+   double Gain( const double* left, const double* right ) const;
+   double Separation( double s, double b ) const;
+   double LeafValue( const double* stats ) const;
+   int    FindLeaf( int root, const unsigned char* codes, size_t stride ) const;
+
+   // options
+   int         fNTrees;
+   int         fMaxDepth;
+   int         fNCuts;
+   int         fNEventsMin;
+   int         fNNodesMax;
+   EBoostType  fBoostType;
+   double      fAdaBoostBeta;
+   bool        fUseYesNoLeaf;
+   ESeparation fSeparation;
+   double      fShrinkage;
+   bool        fUseBaggedGrad;
+   double      fBaggingFraction;
+
+   // the forest
+   std::vector<std::vector<Float_t> > fEdges;        // per variable: codes are the number of edges <= value
+   std::vector<Node>                  fNodes;
+   std::vector<int>                   fRoots;
+   std::vector<double>                fTreeWeights;  // AdaBoost
+
+   // the training events, while training
+   size_t                       fNEvents;
+   int                          fMinNodeEvents;      // nEventsMin, or its default for these events
+   std::vector<unsigned char>   fCodes;              // event-major: fCodes[ievt*nvars + ivar]
+   std::vector<double>          fEventStats;         // kNStats per event
+   std::vector<unsigned int>    fIndex;              // events of the tree, grouped by node
+   int                          fNNodes;             // nodes of the tree being built
+
+   mutable std::vector<unsigned char> fValueCodes;
+};
+
+// evaluates BinnedBDTs on the samples of a ParallelEvaluation, as ReaderEvaluator
+// does the TMVA::Reader methods
+class BinnedBDTEvaluator : public SampleEvaluator {
+
+ public:
+
+   BinnedBDTEvaluator( const std::vector<TString>& backgroundBranches, const std::vector<TString>& signalBranches )
+      : fBackgroundBranches( backgroundBranches ), fSignalBranches( signalBranches ),
+        fValues( backgroundBranches.size() ) {}
+
+   // fill scale*response + offset of "forest" into scans[iscan]; the forest must
+   // outlive the evaluation
+   void AddForest( const BinnedBDT* forest, int iscan, double scale = 1, double offset = 0 )
+   {
+      fForests.push_back( forest );
+      fScans.push_back( iscan );
+      fScales.push_back( scale );
+      fOffsets.push_back( offset );
+   }
+
+   bool Evaluate( TTree* tree, bool isSignal, Long64_t first, Long64_t last,
+                  std::vector<SignificanceScan>& scans );
+   bool Evaluate( const EventCache& cache, bool isSignal, Long64_t first, Long64_t last,
+                  std::vector<SignificanceScan>& scans );
+
+ private:
+
+   void Fill( bool isSignal, Double_t weight, std::vector<SignificanceScan>& scans ) const;
+
+   std::vector<TString>          fBackgroundBranches;
+   std::vector<TString>          fSignalBranches;
+   std::vector<Float_t>          fValues;
+   std::vector<const BinnedBDT*> fForests;
+   std::vector<int>              fScans;
+   std::vector<double>           fScales;
+   std::vector<double>           fOffsets;
+};
+
+//_______________________________________________________________________
+inline BinnedBDT::BinnedBDT( const TString& options )
+   : fNTrees( 800 ), fMaxDepth( 3 ), fNCuts( 20 ), fNEventsMin( -1 ), fNNodesMax( 100000 ),
+     fBoostType( kAdaBoost ), fAdaBoostBeta( 1.0 ), fUseYesNoLeaf( true ), fSeparation( kGiniIndex ),
+     fShrinkage( 1.0 ), fUseBaggedGrad( false ), fBaggingFraction( 0.6 ), fNEvents( 0 ), fMinNodeEvents( 0 ), fNNodes( 0 )
+{
+   std::string text = options.Data();
+   size_t begin = 0;
+   while (begin <= text.size()) {
+      size_t end = text.find( ':', begin );
+      if (end == std::string::npos) end = text.size();
+      std::string option = text.substr( begin, end - begin );
+      begin = end + 1;
+      if (option.empty()) continue;
+
+      // "Flag", "!Flag" or "Key=Value"
+      std::string key = option, value = "true";
+      size_t equal = option.find( '=' );
+      if (equal != std::string::npos) {
+         key   = option.substr( 0, equal );
+         value = option.substr( equal + 1 );
+      }
+      else if (option[0] == '!') {
+         key   = option.substr( 1 );
+         value = "false";
+      }
+      for (size_t i = 0; i < key.size(); i++) key[i] = tolower( key[i] );
+      SetOption( key, value );
+   }
+   if (fNCuts < 1)   fNCuts = 1;
+   if (fNCuts > 254) fNCuts = 254;
+   if (fMaxDepth < 1) fMaxDepth = 1;
+}
+
+//_______________________________________________________________________
+inline void BinnedBDT::SetOption( const std::string& key, const std::string& value )
+{
+   std::string lower = value;
+   for (size_t i = 0; i < lower.size(); i++) lower[i] = tolower( lower[i] );
+   bool flag = lower == "true" || lower == "t" || lower == "1";
+
+   if      (key == "ntrees")              fNTrees          = atoi( value.c_str() );
+   else if (key == "maxdepth")            fMaxDepth        = atoi( value.c_str() );
+   else if (key == "ncuts")               fNCuts           = atoi( value.c_str() );
+   else if (key == "neventsmin")          fNEventsMin      = atoi( value.c_str() );
+   else if (key == "nnodesmax")           fNNodesMax       = atoi( value.c_str() );
+   else if (key == "adaboostbeta")        fAdaBoostBeta    = atof( value.c_str() );
+   else if (key == "useyesnoleaf")        fUseYesNoLeaf    = flag;
+   else if (key == "shrinkage")           fShrinkage       = atof( value.c_str() );
+   else if (key == "usebaggedgrad")       fUseBaggedGrad   = flag;
+   else if (key == "gradbaggingfraction") fBaggingFraction = atof( value.c_str() );
+   else if (key == "boosttype") {
+      if      (lower == "adaboost") fBoostType = kAdaBoost;
+      else if (lower == "grad")     fBoostType = kGrad;
+      else std::cout << "Problem in class \"BinnedBDT\": BoostType " << value << " is not supported, using AdaBoost" << std::endl;
+   }
+   else if (key == "separationtype") {
+      if      (lower == "giniindex")              fSeparation = kGiniIndex;
+      else if (lower == "crossentropy")           fSeparation = kCrossEntropy;
+      else if (lower == "misclassificationerror") fSeparation = kMisClassificationError;
+      else std::cout << "Problem in class \"BinnedBDT\": SeparationType " << value << " is not supported, using GiniIndex" << std::endl;
+   }
+}
+
+//_______________________________________________________________________
+inline bool BinnedBDT::Train( const std::vector<const EventCache*>& samples, const std::vector<bool>& isSignal,
+                              const std::vector<TString>& branches, EventCache::ESelection selection, double fraction )
+{
+   size_t nvars = branches.size();
+   fEdges.clear();
+   fNodes.clear();
+   fRoots.clear();
+   fTreeWeights.clear();
+
+   // --- the training events
+   std::vector<std::vector<Float_t> > values( nvars );
+   std::vector<double> weights;
+   std::vector<bool>   signal;
+   for (size_t isample = 0; isample < samples.size(); isample++) {
+      const EventCache& cache = *samples[isample];
+      std::vector<const Float_t*> columns( nvars );
+      for (size_t ivar = 0; ivar < nvars; ivar++) {
+         int icolumn = cache.GetIndex( branches[ivar] );
+         if (icolumn < 0) {
+            std::cout << "Problem in class \"BinnedBDT\": branch \"" << branches[ivar]
+                      << "\" is not cached for " << cache.GetName() << std::endl;
+            return false;
+         }
+         columns[ivar] = cache.GetColumn( icolumn );
+      }
+      for (Long64_t ievt = 0; ievt < cache.GetNEvents(); ievt++) {
+         if (!cache.IsSelected( ievt, selection ) || !cache.IsTraining( ievt ) ||
+             !EventCache::IsInFraction( ievt, fraction )) continue;
+         for (size_t ivar = 0; ivar < nvars; ivar++) values[ivar].push_back( columns[ivar][ievt] );
+         weights.push_back( cache.GetWeight( ievt ) );
+         signal.push_back( isSignal[isample] );
+      }
+   }
+   fNEvents = weights.size();
+   size_t nsignal = std::count( signal.begin(), signal.end(), true );
+   if (nsignal == 0 || nsignal == fNEvents) {
+      std::cout << "Problem in class \"BinnedBDT\": no training events of a class" << std::endl;
+      return false;
+   }
+   // the option stays as given, so that a second training derives its own default
+   fMinNodeEvents = fNEventsMin;
+   if (fMinNodeEvents < 0) fMinNodeEvents = std::max( 20, int( fNEvents/(10.*(nvars > 0 ? nvars*nvars : 1)) ) );
+
+   Bin( values );
+   values.clear();
+
+   // --- boosting
+   std::vector<double> boostWeights( weights );   // AdaBoost
+   std::vector<double> forest( fNEvents, 0 );     // Grad: the sum F of the trees so far
+   double sumWeights = 0;
+   for (size_t ievt = 0; ievt < fNEvents; ievt++) sumWeights += weights[ievt];
+   fEventStats.assign( fNEvents*kNStats, 0 );
+   unsigned int seed = EventCache::kSplitSeed;
+
+   for (int itree = 0; itree < fNTrees; itree++) {
+      fIndex.clear();
+      for (size_t ievt = 0; ievt < fNEvents; ievt++) {
+         double* stats = &fEventStats[ievt*kNStats];
+         if (fBoostType == kAdaBoost) {
+            stats[0] = signal[ievt] ? boostWeights[ievt] : 0;
+            stats[1] = signal[ievt] ? 0 : boostWeights[ievt];
+            stats[2] = 0;
+         }
+         else {
+            double p = 1/(1 + exp( -2*forest[ievt] ));
+            double r = (signal[ievt] ? 1 : 0) - p;
+            stats[0] = weights[ievt]*r;
+            stats[1] = weights[ievt];
+            stats[2] = weights[ievt]*fabs( r )*(1 - fabs( r ));
+         }
+         stats[3] = 1;
+         // the bagged events of a Grad tree, a 32 bit LCG as for the training split
+         if (fBoostType == kGrad && fUseBaggedGrad) {
+            seed = 1664525*seed + 1013904223;
+            if ((seed >> 8)*(1.0/16777216.0) >= fBaggingFraction) continue;
+         }
+         fIndex.push_back( ievt );
+      }
+
+      std::vector<double> hist;
+      Histogram( 0, fIndex.size(), hist );
+      int root = fNodes.size();
+      fNodes.push_back( Node() );
+      fNNodes = 1;
+      Build( root, 0, fIndex.size(), 0, hist );
+      fRoots.push_back( root );
+
+      if (fBoostType == kGrad) {
+         for (size_t ievt = 0; ievt < fNEvents; ievt++) {
+            forest[ievt] += fNodes[FindLeaf( root, &fCodes[ievt*nvars], 1 )].fValue;
+         }
+         continue;
+      }
+
+      // AdaBoost: raise the weights of the misclassified events by ((1-err)/err)^beta
+      double misclassified = 0, total = 0;
+      std::vector<bool> wrong( fNEvents );
+      for (size_t ievt = 0; ievt < fNEvents; ievt++) {
+         wrong[ievt] = (fNodes[FindLeaf( root, &fCodes[ievt*nvars], 1 )].fValue > 0) != signal[ievt];
+         if (wrong[ievt]) misclassified += boostWeights[ievt];
+         total += boostWeights[ievt];
+      }
+      double err = total > 0 ? misclassified/total : 0.5;
+      if (err <= 0 || err >= 0.5) {
+         // a tree without error, or one no better than chance: boosting cannot go on
+         if (err <= 0) fTreeWeights.push_back( 1 );
+         else          fRoots.pop_back();
+         std::cout << "--- BinnedBDT: AdaBoost stopped after " << fRoots.size() << " trees, error " << err << std::endl;
+         break;
+      }
+      double boost = pow( (1 - err)/err, fAdaBoostBeta );
+      fTreeWeights.push_back( log( boost ) );
+      double sum = 0;
+      for (size_t ievt = 0; ievt < fNEvents; ievt++) {
+         if (wrong[ievt]) boostWeights[ievt] *= boost;
+         sum += boostWeights[ievt];
+      }
+      for (size_t ievt = 0; ievt < fNEvents; ievt++) boostWeights[ievt] *= sumWeights/sum;
+   }
+
+   fCodes.clear();
+   fEventStats.clear();
+   fIndex.clear();
+   return !fRoots.empty();
+}
+
+//_______________________________________________________________________
+inline void BinnedBDT::Bin( const std::vector<std::vector<Float_t> >& values )
+{
+   size_t nvars = values.size();
+   fEdges.assign( nvars, std::vector<Float_t>() );
+   fCodes.assign( fNEvents*nvars, 0 );
+   for (size_t ivar = 0; ivar < nvars; ivar++) {
+      std::vector<Float_t> sorted( values[ivar] );
+      std::sort( sorted.begin(), sorted.end() );
+      std::vector<Float_t>& edges = fEdges[ivar];
+      for (int icut = 1; icut <= fNCuts; icut++) {
+         Float_t edge = sorted[size_t( double(icut)*fNEvents/(fNCuts + 1) )];
+         // an edge at the minimum would leave its lower bin empty
+         if (edge > sorted[0] && (edges.empty() || edge > edges.back())) edges.push_back( edge );
+      }
+      for (size_t ievt = 0; ievt < fNEvents; ievt++) {
+         fCodes[ievt*nvars + ivar] = std::upper_bound( edges.begin(), edges.end(), values[ivar][ievt] ) - edges.begin();
+      }
+   }
+}
+
+//_______________________________________________________________________
+inline void BinnedBDT::Histogram( size_t begin, size_t end, std::vector<double>& hist ) const
+{
+   size_t nvars = fEdges.size(), nbins = fNCuts + 1;
+   hist.assign( nvars*nbins*kNStats, 0 );
+   for (size_t i = begin; i < end; i++) {
+      unsigned int ievt = fIndex[i];
+      const unsigned char* codes = &fCodes[size_t(ievt)*nvars];
+      const double* stats = &fEventStats[size_t(ievt)*kNStats];
+      for (size_t ivar = 0; ivar < nvars; ivar++) {
+         double* bin = &hist[(ivar*nbins + codes[ivar])*kNStats];
+         for (int k = 0; k < kNStats; k++) bin[k] += stats[k];
+      }
+   }
+}
+
+//_______________________________________________________________________
+inline double BinnedBDT::Separation( double s, double b ) const
+{
+   double n = s + b;
+   if (n <= 0) return 0;
+   double p = s/n;
+   if (p <= 0 || p >= 1) return 0;
+   if (fSeparation == kCrossEntropy)           return -p*log( p ) - (1 - p)*log( 1 - p );
+   if (fSeparation == kMisClassificationError) return 1 - std::max( p, 1 - p );
+   return p*(1 - p);
+}
+
+//_______________________________________________________________________
+inline double BinnedBDT::Gain( const double* left, const double* right ) const
+{
+   if (fBoostType == kGrad) {
+      // reduction of the weighted variance of the residuals
+      double sum = left[0] + right[0], weight = left[1] + right[1];
+      if (left[1] <= 0 || right[1] <= 0 || weight <= 0) return 0;
+      return left[0]*left[0]/left[1] + right[0]*right[0]/right[1] - sum*sum/weight;
+   }
+   double sl = left[0], bl = left[1], sr = right[0], br = right[1];
+   return Separation( sl + sr, bl + br )*(sl + sr + bl + br)
+        - Separation( sl, bl )*(sl + bl) - Separation( sr, br )*(sr + br);
+}
+
+//_______________________________________________________________________
+inline double BinnedBDT::LeafValue( const double* stats ) const
+{
+   if (fBoostType == kGrad) {
+      // a Newton step of the binomial log-likelihood, as TMVA's Grad
+      return stats[2] > 0 ? fShrinkage/2*stats[0]/stats[2] : 0;
+   }
+   double n = stats[0] + stats[1];
+   double purity = n > 0 ? stats[0]/n : 0.5;
+   return fUseYesNoLeaf ? (purity > 0.5 ? 1 : -1) : 2*purity - 1;
+}
+
+//_______________________________________________________________________
+inline void BinnedBDT::Build( int inode, size_t begin, size_t end, int depth, const std::vector<double>& hist )
+{
+   size_t nvars = fEdges.size(), nbins = fNCuts + 1;
+
+   // the statistics of the node are those of any variable over all its codes
+   double total[kNStats] = { 0, 0, 0, 0 };
+   for (size_t bin = 0; bin < nbins; bin++) {
+      for (int k = 0; k < kNStats; k++) total[k] += hist[bin*kNStats + k];
+   }
+   fNodes[inode].fVariable = -1;
+   fNodes[inode].fCut      = 0;
+   fNodes[inode].fLeft     = -1;
+   fNodes[inode].fValue    = LeafValue( total );
+
+   bool split = depth < fMaxDepth && total[3] >= 2*fMinNodeEvents && fNNodes + 2 <= fNNodesMax;
+   int bestVariable = -1, bestCut = 0;
+   double bestGain = 0;
+   for (size_t ivar = 0; split && ivar < nvars; ivar++) {
+      int ncodes = fEdges[ivar].size() + 1;
+      double left[kNStats] = { 0, 0, 0, 0 }, right[kNStats];
+      for (int cut = 0; cut + 1 < ncodes; cut++) {
+         const double* bin = &hist[(ivar*nbins + cut)*kNStats];
+         for (int k = 0; k < kNStats; k++) {
+            left[k]  += bin[k];
+            right[k]  = total[k] - left[k];
+         }
+         if (left[3] < fMinNodeEvents || right[3] < fMinNodeEvents) continue;
+         double gain = Gain( left, right );
+         if (gain > bestGain) {
+            bestGain     = gain;
+            bestVariable = ivar;
+            bestCut      = cut;
+         }
+      }
+   }
+   if (bestVariable < 0) return;
+
+   // group the events of the node into those of its children
+   unsigned int* first  = &fIndex[0] + begin;
+   unsigned int* last   = &fIndex[0] + end;
+   unsigned int* middle = first;
+   for (unsigned int* i = first; i != last; i++) {
+      if (fCodes[size_t(*i)*nvars + bestVariable] <= bestCut) std::swap( *i, *middle++ );
+   }
+   size_t center = begin + (middle - first);
+
+   // histogram the smaller child, and the other one by subtraction from the parent
+   std::vector<double> smaller, larger( hist );
+   bool leftSmaller = center - begin <= end - center;
+   if (leftSmaller) Histogram( begin, center, smaller );
+   else             Histogram( center, end, smaller );
+   for (size_t i = 0; i < larger.size(); i++) larger[i] -= smaller[i];
+
+   int left = fNodes.size();
+   fNodes.push_back( Node() );
+   fNodes.push_back( Node() );
+   fNNodes += 2;
+   fNodes[inode].fVariable = bestVariable;
+   fNodes[inode].fCut      = bestCut;
+   fNodes[inode].fLeft     = left;
+   Build( left,     begin,  center, depth + 1, leftSmaller ? smaller : larger );
+   Build( left + 1, center, end,    depth + 1, leftSmaller ? larger : smaller );
+}
+
+//_______________________________________________________________________
+inline int BinnedBDT::FindLeaf( int root, const unsigned char* codes, size_t stride ) const
+{
+   int inode = root;
+   while (fNodes[inode].fVariable >= 0) {
+      const Node& node = fNodes[inode];
+      inode = node.fLeft + (codes[node.fVariable*stride] > node.fCut ? 1 : 0);
+   }
+   return inode;
+}
+
+//_______________________________________________________________________
+inline double BinnedBDT::GetResponse( const Float_t* values ) const
+{
+   size_t nvars = fEdges.size();
+   fValueCodes.resize( nvars );
+   for (size_t ivar = 0; ivar < nvars; ivar++) {
+      const std::vector<Float_t>& edges = fEdges[ivar];
+      fValueCodes[ivar] = std::upper_bound( edges.begin(), edges.end(), values[ivar] ) - edges.begin();
+   }
+
+   double response = 0, norm = 0;
+   for (size_t itree = 0; itree < fRoots.size(); itree++) {
+      double value = fNodes[FindLeaf( fRoots[itree], nvars > 0 ? &fValueCodes[0] : 0, 1 )].fValue;
+      if (fBoostType == kGrad) response += value;
+      else {
+         response += fTreeWeights[itree]*value;
+         norm     += fTreeWeights[itree];
+      }
+   }
+   if (fBoostType == kGrad) return 2/(1 + exp( -2*response )) - 1;
+   return norm > 0 ? response/norm : 0;
+}
+
+//_______________________________________________________________________
+inline bool BinnedBDTEvaluator::Evaluate( TTree* tree, bool isSignal, Long64_t first, Long64_t last,
+                                          std::vector<SignificanceScan>& scans )
+{
+   Float_t weight_70, btweight_70, weight_1btin_70;
+   Int_t analysis_channel;
+
+   const std::vector<TString>& branches = isSignal ? fSignalBranches : fBackgroundBranches;
+   for (size_t ivar = 0; ivar < branches.size(); ivar++) {
+      if (tree->GetBranch( branches[ivar] ) == 0) {
+         std::cout << "Problem in class \"BinnedBDTEvaluator\": no branch \"" << branches[ivar]
+                   << "\" in " << tree->GetName() << std::endl;
+         tree->ResetBranchAddresses();
+         return false;
+      }
+      tree->SetBranchAddress( branches[ivar], &fValues[ivar] );
+   }
+   tree->SetBranchAddress( "weight_70", &weight_70 );
+   tree->SetBranchAddress( "btweight_70", &btweight_70 );
+   tree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70 );
+   tree->SetBranchAddress( "analysis_channel", &analysis_channel );
+
+   for (Long64_t ievt = first; ievt < last; ievt++) {
+      tree->GetEntry( ievt );
+      if (analysis_channel == 0) continue;
+
+      Fill( isSignal, weight_1btin_70*weight_70/btweight_70, scans );
+   }
+
+   tree->ResetBranchAddresses();
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool BinnedBDTEvaluator::Evaluate( const EventCache& cache, bool isSignal, Long64_t first, Long64_t last,
+                                          std::vector<SignificanceScan>& scans )
+{
+   const std::vector<TString>& branches = isSignal ? fSignalBranches : fBackgroundBranches;
+   std::vector<const Float_t*> columns( branches.size() );
+   for (size_t ivar = 0; ivar < branches.size(); ivar++) {
+      int icolumn = cache.GetIndex( branches[ivar] );
+      if (icolumn < 0) {
+         std::cout << "Problem in class \"BinnedBDTEvaluator\": branch \"" << branches[ivar]
+                   << "\" is not cached for " << cache.GetName() << std::endl;
+         return false;
+      }
+      columns[ivar] = cache.GetColumn( icolumn );
+   }
+
+   for (Long64_t ievt = first; ievt < last; ievt++) {
+      for (size_t ivar = 0; ivar < columns.size(); ivar++) fValues[ivar] = columns[ivar][ievt];
+      Fill( isSignal, cache.GetWeight( ievt ), scans );
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline void BinnedBDTEvaluator::Fill( bool isSignal, Double_t weight, std::vector<SignificanceScan>& scans ) const
+{
+   for (size_t iforest = 0; iforest < fForests.size(); iforest++) {
+      double mva = fScales[iforest]*fForests[iforest]->GetResponse( fValues.empty() ? 0 : &fValues[0] ) + fOffsets[iforest];
+      if (isSignal) scans[fScans[iforest]].FillSignal( mva, weight );
+      else          scans[fScans[iforest]].FillBackground( mva, weight );
+   }
+}
+
+#endif
@@ -0,0 +1,387 @@
+// ClassificationTrial: trains and evaluates the methods of a driver on a subset of its variables
+//
+// A trial books its methods on the variables selected by the VariableMask
+// "choice" (bit i is line i of the variable list, the line of analysis_channel is
+// never used), trains them on the training samples and finds the best significance of
+// each method on the test samples, as TMVAClassificationCpp does. The events come
+// from EventCaches, all read through the variable expressions (the second word of
+// a variable line is its title only). It writes TMVA.root and weights/ in the current directory, which is
+// the directory of the trial when it is run by a SubsetSearch.
+//
+// For the MLPs it reports the cycle their training stopped at (see
+// MLPConvergence.h).
+//
+// With SetBinnedBDT, the BDT methods are trained by BinnedBDT on the same
+// training events instead of by the factory (see BinnedBDT.h). With
+// SetCompareBinnedBDT, they are trained by both: the significance of the factory's
+// BDT is the result, and that of the BinnedBDT is reported next to it, on the same
+// training and test events.
+//
+// A trial can train on a fixed fraction of the training events only (see
+// EventCache::AddToFactory), as the early steps of a SuccessiveHalving do.
+//
+// With a SignificanceCache, a method whose training was done before, in this or
+// an earlier run, is not trained again: its significance and cut are taken from
+// the cache, and a trial with all methods cached trains nothing.
+//
+//    ClassificationTrial trial( variables, 1 );
+//    trial.AddTrainingSample( train_signal_cache[0], true );
+//    trial.AddTestSample( background_cache[0], false );
+//    trial.AddMethod( Types::kMLP, "MLP", "!H:!V:NeuronType=tanh:...", 0.7, 1.0, 3000 );
+//    trial.AddMethod( Types::kBDT, "BDT", "!H:!V:NTrees=400:...", 0.5, 0.7, 3000, 0.5, 0.5 );
+//    search.Run( trial );
+
+#ifndef ClassificationTrial__def
+#define ClassificationTrial__def
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+
+#include "TFile.h"
+#include "TString.h"
+#include "TCut.h"
+#include "TMVA/Factory.h"
+#include "TMVA/Reader.h"
+#include "TMVA/Types.h"
+
+#include "SignificanceScan.h"
+#include "ParallelEvaluation.h"
+#include "EventCache.h"
+#include "SubsetSearch.h"
+#include "VariableMask.h"
+#include "SignificanceCache.h"
+#include "MLPConvergence.h"
+#include "BinnedBDT.h"
+
+class ClassificationTrial : public SubsetTrial {
+
+ public:
+
+   // the samples are evaluated on nEvaluationWorkers processes (0: one per core)
+   ClassificationTrial( const std::vector<std::vector<TString> >& variables, int nEvaluationWorkers = 0,
+                        EventCache::ESelection selection = EventCache::kTrainable )
+      : fVariables( variables ), fNEvaluationWorkers( nEvaluationWorkers ), fSelection( selection ),
+        fTrainingFraction( 1 ), fBinnedBDT( false ),
+        fCompareBinnedBDT( false ), fSignificanceCache( 0 ) {}
+
+   void AddTrainingSample( const EventCache* cache, bool isSignal );
+   void AddTestSample( const EventCache* cache, bool isSignal );
+
+   // book the method "name" with the options "options"; its response, as
+   // scale*response + offset, is scanned with nCuts cuts between low and high
+   void AddMethod( TMVA::Types::EMVA type, const TString& name, const TString& options,
+                   double low, double high, int nCuts, double scale = 1, double offset = 0 );
+   void ClearMethods() { fMethods.clear(); }
+
+   // train (and test in the factory) on about the fraction "fraction" of the events
+   void SetTrainingFraction( double fraction ) { fTrainingFraction = fraction; }
+   // train the BDT methods with BinnedBDT instead of the factory
+   void SetBinnedBDT( bool binned ) { fBinnedBDT = binned; }
+   // train the BDT methods with the factory and with BinnedBDT, and report both
+   void SetCompareBinnedBDT( bool compare ) { fCompareBinnedBDT = compare; }
+
+   // take the results of earlier trainings from "cache", and store the new ones
+   void SetSignificanceCache( SignificanceCache* cache ) { fSignificanceCache = cache; }
+
+   void SetNEvaluationWorkers( int nEvaluationWorkers ) { fNEvaluationWorkers = nEvaluationWorkers; }
+
+   // everything the results of all methods on the variables "choice" depend on,
+   // e.g. to tell the journal of one search from that of another
+   std::string Describe( const VariableMask& choice ) const;
+
+   bool Run( const VariableMask& choice, std::vector<std::pair<std::string, double> >& significances );
+
+ private:
+
+   struct Method {
+      TMVA::Types::EMVA type;
+      TString           name;
+      TString           options;
+      double            low, high;
+      int               nCuts;
+      double            scale, offset;
+   };
+
+   bool IsBinned( const Method& method ) const { return fBinnedBDT && method.type == TMVA::Types::kBDT; }
+   bool IsCompared( const Method& method ) const
+   { return fCompareBinnedBDT && !fBinnedBDT && method.type == TMVA::Types::kBDT; }
+
+   // everything the result of training "method" on the variables "choice" depends on
+   std::string Describe( const VariableMask& choice, const Method& method ) const;
+
+   // hash the columns of all variables of a sample now, so that the trials forked
+   // by a SubsetSearch do not each hash them again
+   void Fingerprint( const EventCache* cache ) const;
+
+   static const char* FactoryOptions()
+   { return "!V:Silent:Color:DrawProgressBar:Transformations=I;D;P;G,D:AnalysisType=Classification"; }
+   static const char* SplitOptions()
+   { return "nTrain_Signal=0:nTrain_Background=0:SplitMode=Random:NormMode=NumEvents:!V"; }
+
+   const std::vector<std::vector<TString> >& fVariables;
+   int                                       fNEvaluationWorkers;
+   EventCache::ESelection                    fSelection;
+   double                                    fTrainingFraction;
+   bool                                      fBinnedBDT;
+   bool                                      fCompareBinnedBDT;
+   std::vector<const EventCache*>            fTrainingSamples;
+   std::vector<bool>                         fIsTrainingSignal;
+   std::vector<const EventCache*>            fTestSamples;
+   std::vector<bool>                         fIsTestSignal;
+   std::vector<Method>                       fMethods;
+   SignificanceCache*                        fSignificanceCache;
+};
+
+//_______________________________________________________________________
+inline void ClassificationTrial::AddTrainingSample( const EventCache* cache, bool isSignal )
+{
+   Fingerprint( cache );
+   fTrainingSamples.push_back( cache );
+   fIsTrainingSignal.push_back( isSignal );
+}
+
+//_______________________________________________________________________
+inline void ClassificationTrial::AddTestSample( const EventCache* cache, bool isSignal )
+{
+   Fingerprint( cache );
+   fTestSamples.push_back( cache );
+   fIsTestSignal.push_back( isSignal );
+}
+
+//_______________________________________________________________________
+inline void ClassificationTrial::AddMethod( TMVA::Types::EMVA type, const TString& name, const TString& options,
+                                            double low, double high, int nCuts, double scale, double offset )
+{
+   Method method;
+   method.type    = type;
+   method.name    = name;
+   method.options = options;
+   method.low     = low;
+   method.high    = high;
+   method.nCuts   = nCuts;
+   method.scale   = scale;
+   method.offset  = offset;
+   fMethods.push_back( method );
+}
+
+//_______________________________________________________________________
+inline std::string ClassificationTrial::Describe( const VariableMask& choice, const Method& method ) const
+{
+   std::ostringstream description;
+   description.precision( 17 );
+   description << "variables";
+   for (int i = choice.First(); i >= 0 && i < (int)fVariables.size(); i = choice.Next( i )) {
+      if (fVariables[i][1] == "analysis_channel") continue;
+      description << " " << fVariables[i][0] << " " << fVariables[i][1];
+   }
+   description << "\nmethod " << method.type << " " << method.name << " " << method.options
+               << "\nscan " << method.low << " " << method.high << " " << method.nCuts
+               << " " << method.scale << " " << method.offset
+               << "\nfactory " << FactoryOptions() << " " << SplitOptions()
+               << "\nselection " << fSelection << " split " << EventCache::kSplitSeed;
+   if (fTrainingFraction < 1) description << " fraction " << fTrainingFraction;
+   if (IsBinned( method )) description << "\nengine BinnedBDT";
+   // the samples by their content, so that regenerated or reweighted ntuples do not
+   // match the results of the old ones
+   std::vector<TString> trainBranches;
+   for (int i = choice.First(); i >= 0 && i < (int)fVariables.size(); i = choice.Next( i )) {
+      if (fVariables[i][1] == "analysis_channel") continue;
+      trainBranches.push_back( fVariables[i][0] );
+   }
+   for (size_t isample = 0; isample < fTrainingSamples.size(); isample++) {
+      description << "\ntraining " << fIsTrainingSignal[isample] << " "
+                  << EventCache::GetSnapshotName( "", fTrainingSamples[isample]->GetName() ) << " "
+                  << fTrainingSamples[isample]->GetNEvents() << " "
+                  << fTrainingSamples[isample]->GetFingerprint( trainBranches );
+   }
+   for (size_t isample = 0; isample < fTestSamples.size(); isample++) {
+      description << "\ntest " << fIsTestSignal[isample] << " "
+                  << EventCache::GetSnapshotName( "", fTestSamples[isample]->GetName() ) << " "
+                  << fTestSamples[isample]->GetNEvents() << " "
+                  << fTestSamples[isample]->GetFingerprint( trainBranches );
+   }
+   return description.str();
+}
+
+//_______________________________________________________________________
+inline void ClassificationTrial::Fingerprint( const EventCache* cache ) const
+{
+   std::vector<TString> branches;
+   for (size_t i = 0; i < fVariables.size(); i++) {
+      if (fVariables[i][1] == "analysis_channel") continue;
+      branches.push_back( fVariables[i][0] );
+   }
+   cache->GetFingerprint( branches );
+}
+
+//_______________________________________________________________________
+inline std::string ClassificationTrial::Describe( const VariableMask& choice ) const
+{
+   std::string description;
+   for (size_t imethod = 0; imethod < fMethods.size(); imethod++) {
+      description += Describe( choice, fMethods[imethod] ) + "\n";
+   }
+   return description;
+}
+
+//_______________________________________________________________________
+inline bool ClassificationTrial::Run( const VariableMask& choice, std::vector<std::pair<std::string, double> >& significances )
+{
+   std::vector<TString> trainBranches;
+   std::cerr << "================================================" << std::endl;
+   for (int i = choice.First(); i >= 0 && i < (int)fVariables.size(); i = choice.Next( i )) {
+      if (fVariables[i][1] == "analysis_channel") continue;
+      trainBranches.push_back( fVariables[i][0] );
+      std::cerr << "Adding variable: " << fVariables[i][1] << std::endl;
+   }
+   std::cerr << "================================================" << std::endl;
+
+   // --- the methods without a result in the cache
+   size_t nmethods = fMethods.size();
+   std::vector<std::string> keys( nmethods );
+   std::vector<double> maxSignificance( nmethods ), bestCut( nmethods );
+   std::vector<bool> isCached( nmethods, false );
+   std::vector<size_t> train, trainBinned, compared;
+   for (size_t imethod = 0; imethod < nmethods; imethod++) {
+      if (fSignificanceCache) {
+         keys[imethod] = SignificanceCache::MakeKey( Describe( choice, fMethods[imethod] ) );
+         isCached[imethod] = fSignificanceCache->Find( keys[imethod], maxSignificance[imethod], bestCut[imethod] );
+      }
+      if (IsCompared( fMethods[imethod] )) compared.push_back( imethod );
+      if (isCached[imethod]) continue;
+      if (IsBinned( fMethods[imethod] )) trainBinned.push_back( imethod );
+      else                               train.push_back( imethod );
+   }
+   // the BinnedBDTs trained for comparison only, after those of trainBinned
+   size_t nbinned = trainBinned.size();
+   trainBinned.insert( trainBinned.end(), compared.begin(), compared.end() );
+   std::vector<double> binnedSignificance( nmethods ), binnedCut( nmethods );
+
+   // the methods trained now and their scans on the test samples
+   std::vector<size_t> scanned;
+   std::vector<SignificanceScan> scans;
+
+   if (!train.empty()) {
+      // --- training, with the cached events already split into training and test events
+      TFile* outputFile = TFile::Open( "TMVA.root", "RECREATE" );
+      if (!outputFile) {
+         std::cout << "Problem in class \"ClassificationTrial\": cannot write TMVA.root" << std::endl;
+         return false;
+      }
+      TMVA::Factory* factory = new TMVA::Factory( "TMVAClassification", outputFile, FactoryOptions() );
+      for (int i = choice.First(); i >= 0 && i < (int)fVariables.size(); i = choice.Next( i )) {
+         if (fVariables[i][1] == "analysis_channel") continue;
+         const std::vector<TString>& tup = fVariables[i];
+         factory->AddVariable( tup[0], tup[1], tup[2], tup[3][0] );
+      }
+      bool ok = true;
+      for (size_t isample = 0; ok && isample < fTrainingSamples.size(); isample++) {
+         ok = fTrainingSamples[isample]->AddToFactory( factory, fIsTrainingSignal[isample], trainBranches, fSelection,
+                                                       fTrainingFraction );
+      }
+      if (!ok) {
+         delete factory;
+         outputFile->Close();
+         delete outputFile;
+         return false;
+      }
+      factory->PrepareTrainingAndTestTree( TCut( "" ), TCut( "" ), SplitOptions() );
+      for (size_t itrain = 0; itrain < train.size(); itrain++) {
+         const Method& method = fMethods[train[itrain]];
+         factory->BookMethod( method.type, method.name, method.options );
+      }
+      factory->TrainAllMethods();
+      factory->TestAllMethods();
+      factory->EvaluateAllMethods();
+      outputFile->Close();
+      delete factory;
+      delete outputFile;
+
+      // --- the cycles the MLP trainings stopped at
+      for (size_t itrain = 0; itrain < train.size(); itrain++) {
+         const Method& method = fMethods[train[itrain]];
+         MLPConvergence convergence;
+         if (method.type != TMVA::Types::kMLP || !convergence.Read( "TMVA.root", method.name )) continue;
+         std::cerr << method.name << " stopped at cycle " << convergence.GetStopCycle() << ", best test estimator "
+                   << convergence.GetBestEstimator() << " at cycle " << convergence.GetBestCycle() << std::endl;
+      }
+
+      // --- evaluation of the trained weights on the test samples
+      TMVA::Reader* reader = new TMVA::Reader( "!Color:!Silent" );
+      std::vector<Float_t> values( trainBranches.size() );
+      for (size_t ivar = 0; ivar < trainBranches.size(); ivar++) reader->AddVariable( trainBranches[ivar], &values[ivar] );
+
+      std::vector<SignificanceScan> readerScans;
+      ReaderEvaluator evaluator( reader, values, trainBranches, trainBranches );
+      for (size_t itrain = 0; itrain < train.size(); itrain++) {
+         const Method& method = fMethods[train[itrain]];
+         reader->BookMVA( method.name + " method", "weights/TMVAClassification_" + method.name + ".weights.xml" );
+         evaluator.AddMethod( method.name + " method", itrain, method.scale, method.offset );
+         readerScans.push_back( SignificanceScan( method.low, method.high, method.nCuts ) );
+      }
+      ParallelEvaluation evaluation( fNEvaluationWorkers );
+      for (size_t isample = 0; isample < fTestSamples.size(); isample++) {
+         evaluation.AddSample( fTestSamples[isample], fIsTestSignal[isample] );
+      }
+      ok = evaluation.Run( evaluator, readerScans );
+      delete reader;
+      if (!ok) return false;
+      scanned.insert( scanned.end(), train.begin(), train.end() );
+      scans.insert( scans.end(), readerScans.begin(), readerScans.end() );
+   }
+
+   if (!trainBinned.empty()) {
+      // --- training of the BDTs on the binned training events, and their evaluation
+      std::vector<BinnedBDT*> forests;
+      std::vector<SignificanceScan> binnedScans;
+      BinnedBDTEvaluator evaluator( trainBranches, trainBranches );
+      bool ok = true;
+      for (size_t itrain = 0; ok && itrain < trainBinned.size(); itrain++) {
+         const Method& method = fMethods[trainBinned[itrain]];
+         forests.push_back( new BinnedBDT( method.options ) );
+         ok = forests.back()->Train( fTrainingSamples, fIsTrainingSignal, trainBranches, fSelection, fTrainingFraction );
+         evaluator.AddForest( forests.back(), itrain, method.scale, method.offset );
+         binnedScans.push_back( SignificanceScan( method.low, method.high, method.nCuts ) );
+      }
+      if (ok) {
+         ParallelEvaluation evaluation( fNEvaluationWorkers );
+         for (size_t isample = 0; isample < fTestSamples.size(); isample++) {
+            evaluation.AddSample( fTestSamples[isample], fIsTestSignal[isample] );
+         }
+         ok = evaluation.Run( evaluator, binnedScans );
+      }
+      for (size_t iforest = 0; iforest < forests.size(); iforest++) delete forests[iforest];
+      if (!ok) return false;
+      scanned.insert( scanned.end(), trainBinned.begin(), trainBinned.begin() + nbinned );
+      scans.insert( scans.end(), binnedScans.begin(), binnedScans.begin() + nbinned );
+      for (size_t iscan = nbinned; iscan < binnedScans.size(); iscan++) {
+         binnedSignificance[trainBinned[iscan]] = binnedScans[iscan].GetMaxSignificance();
+         binnedCut[trainBinned[iscan]]          = binnedScans[iscan].GetCut( binnedScans[iscan].GetBestCut() );
+      }
+   }
+
+   for (size_t iscan = 0; iscan < scanned.size(); iscan++) {
+      size_t imethod = scanned[iscan];
+      maxSignificance[imethod] = scans[iscan].GetMaxSignificance();
+      bestCut[imethod]         = scans[iscan].GetCut( scans[iscan].GetBestCut() );
+      if (fSignificanceCache) {
+         fSignificanceCache->Store( keys[imethod], fMethods[imethod].name, maxSignificance[imethod], bestCut[imethod] );
+      }
+   }
+
+   for (size_t imethod = 0; imethod < nmethods; imethod++) {
+      std::cerr << fMethods[imethod].name << " Significance: " << maxSignificance[imethod]
+                << " at cut " << bestCut[imethod] << (isCached[imethod] ? " (cached)" : "") << std::endl;
+      if (IsCompared( fMethods[imethod] )) {
+         std::cerr << fMethods[imethod].name << " BinnedBDT Significance: " << binnedSignificance[imethod]
+                   << " at cut " << binnedCut[imethod] << ", difference to TMVA "
+                   << binnedSignificance[imethod] - maxSignificance[imethod] << std::endl;
+      }
+      significances.push_back( std::make_pair( std::string( fMethods[imethod].name.Data() ), maxSignificance[imethod] ) );
+   }
+   return true;
+}
+
+#endif
@@ -0,0 +1,236 @@
+// ColumnInput: float columns of events, from a snapshot or a CSV file, without ROOT
+//
+// A snapshot written by EventCache::WriteSnapshot (see EventCache.h) is mapped with
+// mmap and its float columns are read in place; the "__weight" and "__flags"
+// columns are not columns here. A CSV file has a header line with the column
+// names and one line per event, the values separated by commas; it is read once
+// into memory. Rows of any choice of columns are gathered with GetRows, in the
+// layout of IClassifierReader::GetMvaValues.
+//
+//    ColumnInput input;
+//    if (!input.Open( "snapshots/nominal_el/ttbar.snap" )) return 1;
+//    std::vector<int> columns = input.GetIndices( names );   // -1 for a missing name
+//    input.GetRows( columns, first, n, &rows[0] );           // rows[i*names.size() + j]
+
+#ifndef ColumnInput__def
+#define ColumnInput__def
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class ColumnInput {
+
+ public:
+
+   ColumnInput() : fNEvents( 0 ), fMap( 0 ), fMapSize( 0 ) {}
+   ~ColumnInput() { Close(); }
+
+   // a snapshot if the file starts as one, a CSV file otherwise
+   bool Open( const std::string& path );
+   void Close();
+
+   size_t GetNEvents() const  { return fNEvents; }
+   size_t GetNColumns() const { return fNames.size(); }
+   const std::string& GetName( size_t icol ) const { return fNames[icol]; }
+   const float* GetColumn( size_t icol ) const { return fColumns[icol]; }
+
+   // index of the column "name", -1 if there is none
+   int GetIndex( const std::string& name ) const;
+   std::vector<int> GetIndices( const std::vector<std::string>& names ) const;
+
+   // the events first, ..., first+n-1 with the values of "columns" in a row each
+   void GetRows( const std::vector<int>& columns, size_t first, size_t n, float* rows ) const;
+
+ private:
+
+   ColumnInput( const ColumnInput& );
+   ColumnInput& operator=( const ColumnInput& );
+
+   bool OpenSnapshot( const std::string& path );
+   bool ReadCSV( const std::string& path );
+
+   enum { kSnapshotAlign = 64 };
+
+   std::string                     fPath;
+   size_t                          fNEvents;
+   std::vector<std::string>        fNames;
+   std::vector<const float*>       fColumns;
+   std::vector<std::vector<float> > fOwned;    // the columns of a CSV file
+   void*                           fMap;
+   size_t                          fMapSize;
+};
+
+//_______________________________________________________________________
+inline bool ColumnInput::Open( const std::string& path )
+{
+   Close();
+   fPath = path;
+   char magic[8] = { 0 };
+   FILE* file = fopen( path.c_str(), "rb" );
+   if (!file) {
+      std::cout << "Problem in class \"ColumnInput\": cannot read " << path << std::endl;
+      return false;
+   }
+   bool isSnapshot = fread( magic, 1, 8, file ) == 8 && memcmp( magic, "EVCACHE3", 8 ) == 0;
+   fclose( file );
+   return isSnapshot ? OpenSnapshot( path ) : ReadCSV( path );
+}
+
+//_______________________________________________________________________
+inline void ColumnInput::Close()
+{
+   if (fMap) munmap( fMap, fMapSize );
+   fMap     = 0;
+   fMapSize = 0;
+   fNEvents = 0;
+   fNames.clear();
+   fColumns.clear();
+   fOwned.clear();
+}
+
+//_______________________________________________________________________
+inline bool ColumnInput::OpenSnapshot( const std::string& path )
+{
+   int fd = open( path.c_str(), O_RDONLY );
+   if (fd < 0) return false;
+   struct stat status;
+   void* map = MAP_FAILED;
+   if (fstat( fd, &status ) == 0 && status.st_size > 0) {
+      map = mmap( 0, status.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+   }
+   close( fd );
+   if (map == MAP_FAILED) {
+      std::cout << "Problem in class \"ColumnInput\": cannot map " << path << std::endl;
+      return false;
+   }
+   fMap     = map;
+   fMapSize = status.st_size;
+
+   // the header of EventCache::WriteSnapshot
+   const char* begin = (const char*)map;
+   const char* end   = begin + status.st_size;
+   const char* p     = begin + 8;
+   unsigned long long nevents = 0;
+   unsigned int ncolumns = 0, sourceLength = 0;
+   bool ok = end - begin >= 48;
+   if (ok) {
+      memcpy( &nevents, p, sizeof(nevents) );
+      memcpy( &ncolumns, p + 8, sizeof(ncolumns) );
+      memcpy( &sourceLength, p + 36, sizeof(sourceLength) );
+      p += 40;
+      fNEvents = nevents;
+      ok = (unsigned long long)(end - p) >= sourceLength;
+      p += ok ? sourceLength : 0;
+   }
+   for (unsigned int icol = 0; ok && icol < ncolumns; icol++) {
+      unsigned int length = 0;
+      ok = end - p >= 4;
+      if (ok) {
+         memcpy( &length, p, sizeof(length) );
+         p += 4;
+         ok = (unsigned long long)(end - p) >= length + 9ULL;
+      }
+      if (!ok) break;
+      std::string name( p, length );
+      char type = p[length];
+      unsigned long long offset;
+      memcpy( &offset, p + length + 1, sizeof(offset) );
+      p += length + 9;
+
+      size_t size = type == 'F' ? sizeof(float) : type == 'D' ? sizeof(double) : type == 'B' ? 1 : 0;
+      ok = size > 0 && offset % kSnapshotAlign == 0 && offset <= (unsigned long long)status.st_size
+         && (status.st_size - offset)/size >= nevents;
+      if (ok && type == 'F' && name.compare( 0, 2, "__" ) != 0) {
+         fNames.push_back( name );
+         fColumns.push_back( (const float*)(begin + offset) );
+      }
+   }
+   if (!ok) {
+      std::cout << "Problem in class \"ColumnInput\": " << path << " is not a snapshot" << std::endl;
+      Close();
+      return false;
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool ColumnInput::ReadCSV( const std::string& path )
+{
+   std::ifstream in( path.c_str() );
+   std::string line;
+   if (!in || !std::getline( in, line )) {
+      std::cout << "Problem in class \"ColumnInput\": cannot read " << path << std::endl;
+      return false;
+   }
+   std::istringstream header( line );
+   std::string name;
+   while (std::getline( header, name, ',' )) {
+      size_t first = name.find_first_not_of( " \t\r" );
+      size_t last  = name.find_last_not_of( " \t\r" );
+      fNames.push_back( first == std::string::npos ? "" : name.substr( first, last - first + 1 ) );
+   }
+   fOwned.resize( fNames.size() );
+
+   for (size_t iline = 2; std::getline( in, line ); iline++) {
+      if (line.find_first_not_of( " \t\r" ) == std::string::npos) continue;
+      const char* p = line.c_str();
+      for (size_t icol = 0; icol < fNames.size(); icol++) {
+         char* next;
+         float value = strtof( p, &next );
+         while (*next == ' ' || *next == '\t' || *next == '\r') next++;
+         bool last = icol + 1 == fNames.size();
+         if (next == p || *next != (last ? '\0' : ',')) {
+            std::cout << "Problem in class \"ColumnInput\": line " << iline << " of " << path
+                      << " does not hold " << fNames.size() << " numbers" << std::endl;
+            Close();
+            return false;
+         }
+         fOwned[icol].push_back( value );
+         p = next + 1;
+      }
+      fNEvents++;
+   }
+   for (size_t icol = 0; icol < fOwned.size(); icol++) {
+      fColumns.push_back( fOwned[icol].empty() ? 0 : &fOwned[icol][0] );
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline int ColumnInput::GetIndex( const std::string& name ) const
+{
+   for (size_t icol = 0; icol < fNames.size(); icol++) {
+      if (fNames[icol] == name) return icol;
+   }
+   return -1;
+}
+
+//_______________________________________________________________________
+inline std::vector<int> ColumnInput::GetIndices( const std::vector<std::string>& names ) const
+{
+   std::vector<int> indices;
+   for (size_t iname = 0; iname < names.size(); iname++) indices.push_back( GetIndex( names[iname] ) );
+   return indices;
+}
+
+//_______________________________________________________________________
+inline void ColumnInput::GetRows( const std::vector<int>& columns, size_t first, size_t n, float* rows ) const
+{
+   const size_t stride = columns.size();
+   for (size_t j = 0; j < stride; j++) {
+      const float* column = fColumns[columns[j]] + first;
+      for (size_t i = 0; i < n; i++) rows[i*stride + j] = column[i];
+   }
+}
+
+#endif
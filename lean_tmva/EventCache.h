@@ -0,0 +1,550 @@
+// EventCache: the events of a mini tree decoded once into float columns
+//
+// Each column asked for is a branch of any leaf type or an expression of branches,
+// as given to factory->AddVariable, evaluated with a TTreeFormula into floats; only
+// the branches they read are enabled, together with the weight and selection
+// branches. Events with analysis_channel 0 are dropped, as in the evaluation of
+// the drivers; the others keep their event weight
+// weight_1btin_70*weight_70/btweight_70, evaluated once into a column, and a bit
+// for each of the training preselections of the drivers:
+//
+//    kTrainable           weight_70>0 && analysis_channel>0
+//    kTrainableChannelOne weight_70>0 && analysis_channel==1
+//
+// Each event is also assigned once to the
+// training or test half, with a fixed seed, so that every trial trains on the
+// same split (as PrepareTrainingAndTestTree with SplitMode=Random does).
+//
+// A cache can be written to a snapshot file and opened again with mmap: the
+// columns are then read in place from the page cache, which concurrent jobs on
+// the same samples share. A snapshot holds, in native byte order,
+//
+//    char     magic[8]          "EVCACHE3"
+//    uint64   number of events
+//    uint32   number of columns
+//    uint64   entries, size and modification time of the source file
+//    uint32   length of the name of the source file, the name
+//    per column: uint32 length of the name, the name, a type ('F' float, 'D' double,
+//                'B' byte) and the uint64 offset of its data in the file
+//
+// with the data of each column aligned to kSnapshotAlign bytes. Besides the
+// branches there are the columns "__weight" (D) and "__flags" (B).
+//
+//    EventCache* cache = EventCache::Decode( ttbar_el, branches );
+//    TString snapshot = EventCache::GetSnapshotName( "snapshots", cache->GetName() );
+//    cache->WriteSnapshot( snapshot );   // e.g. snapshots/nominal_el/ttbar-<hash>.snap
+//    EventCache* mapped = EventCache::OpenSnapshot( snapshot );
+//    const Float_t* lep_pt = mapped->GetColumn( mapped->GetIndex( "lep_pt" ) );
+//    mapped->AddToFactory( factory, false, branches );   // background events of a training
+//
+// EventCache::Load maps the snapshot of a tree if it holds all branches and was
+// written from the tree as it is now (the same file name, number of entries, file
+// size and modification time), and decodes the tree otherwise.
+//
+// A snapshot is not a copy of its tree: the events with analysis_channel 0 are not
+// in it, and there are no integer columns. TMVAClassificationApplication in
+// snezana-replicate/training_code_v2 writes one friend tree entry per tree entry,
+// with runNumber and eventNumber, so it reads the trees.
+
+#ifndef EventCache__def
+#define EventCache__def
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "TTree.h"
+#include "TTreeFormula.h"
+#include "TLeaf.h"
+#include "TBranch.h"
+#include "TString.h"
+#include "TMVA/Factory.h"
+
+class EventCache {
+
+ public:
+
+   // the training preselections, a bit in the flags of each event
+   enum ESelection { kTrainable = 1, kTrainableChannelOne = 4 };
+   // seed of the training split
+   enum { kSplitSeed = 100 };
+
+   // the events of "tree" with the columns "branches", each a branch or an expression
+   // of branches; 0 if one of them or the weight and selection branches cannot be read
+   static EventCache* Decode( TTree* tree, const std::vector<TString>& branches );
+   ~EventCache();
+
+   // the snapshot of the tree in the directory "dir" if it holds all branches,
+   // else a cache decoded from the tree (0 if it cannot be decoded)
+   static EventCache* Load( TTree* tree, const std::vector<TString>& branches, const TString& dir = "snapshots" );
+
+   // map a snapshot written by WriteSnapshot, 0 if it cannot be read
+   static EventCache* OpenSnapshot( const TString& path );
+   bool WriteSnapshot( const TString& path ) const;
+
+   // snapshot of the sample file "file" in the directory "dir": the last two parts
+   // of the file name and a hash of all of it (e.g. nominal_el/ttbar-<hash>.snap)
+   static TString GetSnapshotName( const TString& dir, const TString& file );
+
+   Long64_t GetNEvents() const { return fNEvents; }
+   // name of the file of the tree, also for a snapshot of it
+   const TString& GetName() const { return fName; }
+
+   // column of a branch, -1 if it was not cached
+   int  GetIndex( const TString& branch ) const;
+   bool HasBranches( const std::vector<TString>& branches ) const;
+   const Float_t* GetColumn( int icolumn ) const { return fColumns[icolumn]; }
+   Float_t GetValue( int icolumn, Long64_t ievt ) const { return fColumns[icolumn][ievt]; }
+
+   // a hash of the weights, the flags and the columns of "branches" (a branch that is
+   // not cached counts as such), the same for a cache and its snapshot; the hash of
+   // a column is computed on its first use only
+   std::string GetFingerprint( const std::vector<TString>& branches ) const;
+
+   Double_t GetWeight( Long64_t ievt ) const { return fWeights[ievt]; }
+   bool     IsSelected( Long64_t ievt, ESelection selection = kTrainable ) const { return fFlags[ievt] & selection; }
+   bool     IsTraining( Long64_t ievt ) const { return fFlags[ievt] & kTraining; }
+
+   // add the events passing the preselection to the factory as signal or
+   // background, with the branches "branches" as the variables given to
+   // factory->AddVariable; returns false if one of them was not cached. With
+   // fraction < 1 only a fixed subset of about that fraction of the events is
+   // added, the subset of a smaller fraction being part of that of a larger one
+   bool AddToFactory( TMVA::Factory* factory, bool isSignal, const std::vector<TString>& branches,
+                      ESelection selection = kTrainable, double fraction = 1 ) const;
+
+   // whether event ievt is in the subset of the fraction "fraction" of the events
+   static bool IsInFraction( Long64_t ievt, double fraction );
+
+ private:
+
+   enum { kTraining = 2 };
+   enum { kSnapshotAlign = 64 };
+
+   EventCache() : fNEvents( 0 ), fWeights( 0 ), fFlags( 0 ), fMap( 0 ), fMapSize( 0 ), fEventHash( 0 )
+   { fSource[0] = fSource[1] = fSource[2] = 0; }
+   EventCache( const EventCache& );
+   EventCache& operator=( const EventCache& );
+
+   TString                     fName;
+   std::vector<TString>        fBranches;
+   Long64_t                    fNEvents;
+   // entries, size and modification time of the file of the tree
+   unsigned long long          fSource[3];
+
+   // the columns, in the vectors below or in the mapped snapshot
+   std::vector<const Float_t*> fColumns;
+   const Double_t*             fWeights;
+   const unsigned char*        fFlags;
+
+   std::vector<std::vector<Float_t> > fColumnData;
+   std::vector<Double_t>              fWeightData;
+   std::vector<unsigned char>         fFlagData;
+   void*                              fMap;
+   size_t                             fMapSize;
+
+   static unsigned long long Hash( const void* data, size_t size, unsigned long long hash );
+   static void GetSource( TTree* tree, unsigned long long source[3] );
+
+   // of the weights and flags, and of each column, 0 until computed
+   mutable unsigned long long              fEventHash;
+   mutable std::vector<unsigned long long> fColumnHashes;
+};
+
+//_______________________________________________________________________
+inline EventCache* EventCache::Decode( TTree* tree, const std::vector<TString>& branches )
+{
+   EventCache* cache = new EventCache();
+   cache->fName = tree->GetCurrentFile() ? tree->GetCurrentFile()->GetName() : tree->GetName();
+   for (size_t ibranch = 0; ibranch < branches.size(); ibranch++) {
+      if (cache->GetIndex( branches[ibranch] ) < 0) cache->fBranches.push_back( branches[ibranch] );
+   }
+   const size_t ncolumns = cache->fBranches.size();
+   cache->fColumnData.resize( ncolumns );
+   GetSource( tree, cache->fSource );
+
+   // a formula per column, so that expressions and leaves of any type are read as
+   // the factory reads them; only the leaves of the formulas are enabled
+   tree->SetBranchStatus( "*", 1 );
+   std::vector<TTreeFormula*> formulas;
+   bool ok = true;
+   for (size_t icol = 0; ok && icol < ncolumns; icol++) {
+      formulas.push_back( new TTreeFormula( cache->fBranches[icol], cache->fBranches[icol], tree ) );
+      ok = formulas.back()->GetNdim() > 0;
+      if (!ok) {
+         std::cout << "Problem in class \"EventCache\": cannot read \"" << cache->fBranches[icol]
+                   << "\" from " << cache->fName << std::endl;
+      }
+   }
+   tree->SetBranchStatus( "*", 0 );
+   for (size_t icol = 0; ok && icol < ncolumns; icol++) {
+      for (int ileaf = 0; ileaf < formulas[icol]->GetNcodes(); ileaf++) {
+         TLeaf* leaf = formulas[icol]->GetLeaf( ileaf );
+         if (leaf) tree->SetBranchStatus( leaf->GetBranch()->GetName(), 1 );
+      }
+   }
+
+   Float_t weight_70, btweight_70, weight_1btin_70;
+   Int_t analysis_channel;
+   const char* selection[4] = { "weight_70", "btweight_70", "weight_1btin_70", "analysis_channel" };
+   for (int i = 0; i < 4; i++) tree->SetBranchStatus( selection[i], 1 );
+   if (ok) {
+      ok = tree->SetBranchAddress( "weight_70", &weight_70 ) >= 0
+         && tree->SetBranchAddress( "btweight_70", &btweight_70 ) >= 0
+         && tree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70 ) >= 0
+         && tree->SetBranchAddress( "analysis_channel", &analysis_channel ) >= 0;
+      if (!ok) {
+         std::cout << "Problem in class \"EventCache\": cannot read the weight and selection branches from "
+                   << cache->fName << std::endl;
+      }
+   }
+
+   // the training split, a 32 bit LCG to leave rand() of the drivers alone
+   unsigned int seed = kSplitSeed;
+
+   Long64_t nentries = ok ? tree->GetEntries() : 0;
+   for (Long64_t ievt = 0; ievt < nentries; ievt++) {
+      tree->GetEntry( ievt );
+      seed = 1664525*seed + 1013904223;
+      if (analysis_channel == 0) continue;
+
+      for (size_t icol = 0; icol < ncolumns; icol++) {
+         formulas[icol]->GetNdata();
+         cache->fColumnData[icol].push_back( formulas[icol]->EvalInstance() );
+      }
+      cache->fWeightData.push_back( weight_1btin_70*weight_70/btweight_70 );
+      unsigned char flags = 0;
+      if (weight_70 > 0 && analysis_channel > 0)  flags |= kTrainable;
+      if (weight_70 > 0 && analysis_channel == 1) flags |= kTrainableChannelOne;
+      if (seed & 0x80000000) flags |= kTraining;
+      cache->fFlagData.push_back( flags );
+   }
+
+   for (size_t icol = 0; icol < formulas.size(); icol++) delete formulas[icol];
+   tree->ResetBranchAddresses();
+   tree->SetBranchStatus( "*", 1 );
+   if (!ok) {
+      delete cache;
+      return 0;
+   }
+
+   cache->fNEvents = cache->fWeightData.size();
+   for (size_t icol = 0; icol < ncolumns; icol++) {
+      cache->fColumns.push_back( cache->fNEvents > 0 ? &cache->fColumnData[icol][0] : 0 );
+   }
+   cache->fWeights = cache->fNEvents > 0 ? &cache->fWeightData[0] : 0;
+   cache->fFlags   = cache->fNEvents > 0 ? &cache->fFlagData[0] : 0;
+   return cache;
+}
+
+//_______________________________________________________________________
+inline EventCache::~EventCache()
+{
+   if (fMap) munmap( fMap, fMapSize );
+}
+
+//_______________________________________________________________________
+inline EventCache* EventCache::Load( TTree* tree, const std::vector<TString>& branches, const TString& dir )
+{
+   TString file = tree->GetCurrentFile() ? tree->GetCurrentFile()->GetName() : tree->GetName();
+   EventCache* cache = OpenSnapshot( GetSnapshotName( dir, file ) );
+   if (cache) {
+      unsigned long long source[3];
+      GetSource( tree, source );
+      bool current = cache->fName == file && cache->fSource[0] == source[0]
+                  && cache->fSource[1] == source[1] && cache->fSource[2] == source[2];
+      if (!current) {
+         std::cout << "Problem in class \"EventCache\": the snapshot of " << file
+                   << " was written from another version of it, the tree is read" << std::endl;
+      }
+      if (current && cache->HasBranches( branches )) return cache;
+   }
+   delete cache;
+   return Decode( tree, branches );
+}
+
+//_______________________________________________________________________
+inline void EventCache::GetSource( TTree* tree, unsigned long long source[3] )
+{
+   // as the file tells them, so that remote files are recognised as well
+   TFile* file = tree->GetCurrentFile();
+   source[0] = tree->GetEntries();
+   source[1] = file ? file->GetSize() : 0;
+   source[2] = file ? file->GetModificationDate().Convert() : 0;
+}
+
+//_______________________________________________________________________
+inline int EventCache::GetIndex( const TString& branch ) const
+{
+   for (size_t icol = 0; icol < fBranches.size(); icol++) {
+      if (fBranches[icol] == branch) return icol;
+   }
+   return -1;
+}
+
+//_______________________________________________________________________
+inline bool EventCache::HasBranches( const std::vector<TString>& branches ) const
+{
+   for (size_t ibranch = 0; ibranch < branches.size(); ibranch++) {
+      if (GetIndex( branches[ibranch] ) < 0) return false;
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline unsigned long long EventCache::Hash( const void* data, size_t size, unsigned long long hash )
+{
+   // 64 bit FNV-1a, on 32 bit words as far as they go
+   const unsigned char* p = (const unsigned char*)data;
+   size_t nwords = size/4;
+   for (size_t i = 0; i < nwords; i++) {
+      unsigned int word;
+      memcpy( &word, p + 4*i, 4 );
+      hash ^= word;
+      hash *= 1099511628211ULL;
+   }
+   for (size_t i = 4*nwords; i < size; i++) {
+      hash ^= p[i];
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+//_______________________________________________________________________
+inline std::string EventCache::GetFingerprint( const std::vector<TString>& branches ) const
+{
+   const unsigned long long basis = 14695981039346656037ULL;
+   if (fEventHash == 0) {
+      fEventHash = Hash( fWeights, fNEvents*sizeof(Double_t), basis );
+      fEventHash = Hash( fFlags, fNEvents, fEventHash );
+   }
+   if (fColumnHashes.size() < fColumns.size()) fColumnHashes.resize( fColumns.size(), 0 );
+
+   unsigned long long hash = fEventHash;
+   for (size_t ibranch = 0; ibranch < branches.size(); ibranch++) {
+      int icol = GetIndex( branches[ibranch] );
+      hash = Hash( branches[ibranch].Data(), branches[ibranch].Length() + 1, hash );
+      if (icol < 0) continue;
+      if (fColumnHashes[icol] == 0) fColumnHashes[icol] = Hash( fColumns[icol], fNEvents*sizeof(Float_t), basis );
+      hash = Hash( &fColumnHashes[icol], sizeof(fColumnHashes[icol]), hash );
+   }
+   char fingerprint[17];
+   snprintf( fingerprint, sizeof(fingerprint), "%016llx", hash );
+   return fingerprint;
+}
+
+//_______________________________________________________________________
+inline TString EventCache::GetSnapshotName( const TString& dir, const TString& file )
+{
+   std::string name( file.Data() );
+   size_t slash = name.rfind( '/' );
+   if (slash != std::string::npos && slash > 0) {
+      size_t parent = name.rfind( '/', slash - 1 );
+      if (parent != std::string::npos) name = name.substr( parent + 1 );
+   }
+   if (!name.empty() && name[0] == '/') name.erase( 0, 1 );
+   size_t dot = name.rfind( '.' );
+   if (dot != std::string::npos && name.find( '/', dot ) == std::string::npos) name.erase( dot );
+   // the same two parts of the name can stand for several files
+   char hash[18];
+   snprintf( hash, sizeof(hash), "-%016llx", Hash( file.Data(), file.Length(), 14695981039346656037ULL ) );
+   return dir + "/" + TString( name ) + hash + ".snap";
+}
+
+//_______________________________________________________________________
+inline bool EventCache::WriteSnapshot( const TString& path ) const
+{
+   // the header, followed by the columns at their aligned offsets
+   std::vector<std::string> names;
+   std::vector<char>        types;
+   std::vector<size_t>      sizes;
+   std::vector<const void*> data;
+   for (size_t icol = 0; icol < fBranches.size(); icol++) {
+      names.push_back( fBranches[icol].Data() );
+      types.push_back( 'F' );
+      sizes.push_back( fNEvents*sizeof(Float_t) );
+      data.push_back( fColumns[icol] );
+   }
+   names.push_back( "__weight" );
+   types.push_back( 'D' );
+   sizes.push_back( fNEvents*sizeof(Double_t) );
+   data.push_back( fWeights );
+   names.push_back( "__flags" );
+   types.push_back( 'B' );
+   sizes.push_back( fNEvents*sizeof(unsigned char) );
+   data.push_back( fFlags );
+
+   unsigned long long nevents = fNEvents;
+   unsigned int ncolumns = names.size();
+   unsigned int sourceLength = fName.Length();
+   std::string header( "EVCACHE3", 8 );
+   header.append( (const char*)&nevents, sizeof(nevents) );
+   header.append( (const char*)&ncolumns, sizeof(ncolumns) );
+   header.append( (const char*)fSource, sizeof(fSource) );
+   header.append( (const char*)&sourceLength, sizeof(sourceLength) );
+   header.append( fName.Data(), sourceLength );
+   size_t headerSize = header.size();
+   for (size_t icol = 0; icol < names.size(); icol++) {
+      headerSize += sizeof(unsigned int) + names[icol].size() + 1 + sizeof(unsigned long long);
+   }
+   std::vector<unsigned long long> offsets( names.size() );
+   unsigned long long offset = headerSize;
+   for (size_t icol = 0; icol < names.size(); icol++) {
+      offset = (offset + kSnapshotAlign - 1)/kSnapshotAlign*kSnapshotAlign;
+      offsets[icol] = offset;
+      offset += sizes[icol];
+   }
+   for (size_t icol = 0; icol < names.size(); icol++) {
+      unsigned int length = names[icol].size();
+      header.append( (const char*)&length, sizeof(length) );
+      header.append( names[icol] );
+      header.push_back( types[icol] );
+      header.append( (const char*)&offsets[icol], sizeof(offsets[icol]) );
+   }
+
+   // written to a temporary file first, so that a snapshot is complete or missing
+   TString temporary = path + ".tmp";
+   FILE* file = fopen( temporary, "wb" );
+   if (!file) {
+      std::cout << "Problem in class \"EventCache\": cannot write " << temporary << std::endl;
+      return false;
+   }
+   bool ok = fwrite( header.data(), 1, header.size(), file ) == header.size();
+   unsigned long long position = header.size();
+   const char zeros[kSnapshotAlign] = { 0 };
+   for (size_t icol = 0; ok && icol < names.size(); icol++) {
+      size_t padding = offsets[icol] - position;
+      ok = fwrite( zeros, 1, padding, file ) == padding;
+      if (ok && sizes[icol] > 0) ok = fwrite( data[icol], 1, sizes[icol], file ) == sizes[icol];
+      position = offsets[icol] + sizes[icol];
+   }
+   ok = (fclose( file ) == 0) && ok;
+   if (ok) ok = rename( temporary, path ) == 0;
+   if (!ok) {
+      std::cout << "Problem in class \"EventCache\": cannot write " << path << std::endl;
+      remove( temporary );
+   }
+   return ok;
+}
+
+//_______________________________________________________________________
+inline EventCache* EventCache::OpenSnapshot( const TString& path )
+{
+   int fd = open( path, O_RDONLY );
+   if (fd < 0) return 0;
+   struct stat status;
+   void* map = MAP_FAILED;
+   if (fstat( fd, &status ) == 0 && status.st_size > 0) {
+      map = mmap( 0, status.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+   }
+   close( fd );
+   if (map == MAP_FAILED) {
+      std::cout << "Problem in class \"EventCache\": cannot map " << path << std::endl;
+      return 0;
+   }
+
+   EventCache* cache = new EventCache();
+   cache->fMap     = map;
+   cache->fMapSize = status.st_size;
+
+   const char* begin = (const char*)map;
+   const char* end   = begin + status.st_size;
+   const char* p     = begin;
+   unsigned long long nevents = 0;
+   unsigned int ncolumns = 0, sourceLength = 0;
+   bool ok = end - p >= 48 && memcmp( p, "EVCACHE3", 8 ) == 0;
+   if (ok) {
+      memcpy( &nevents, p + 8, sizeof(nevents) );
+      memcpy( &ncolumns, p + 16, sizeof(ncolumns) );
+      memcpy( cache->fSource, p + 20, sizeof(cache->fSource) );
+      memcpy( &sourceLength, p + 44, sizeof(sourceLength) );
+      p += 48;
+      cache->fNEvents = nevents;
+      ok = (unsigned long long)(end - p) >= sourceLength;
+   }
+   if (ok) {
+      cache->fName = TString( p, sourceLength );
+      p += sourceLength;
+   }
+   for (unsigned int icol = 0; ok && icol < ncolumns; icol++) {
+      unsigned int length = 0;
+      ok = end - p >= 4;
+      if (ok) {
+         memcpy( &length, p, sizeof(length) );
+         p += 4;
+         ok = (unsigned long long)(end - p) >= length + 9ULL;
+      }
+      if (!ok) break;
+      std::string name( p, length );
+      char type = p[length];
+      unsigned long long offset;
+      memcpy( &offset, p + length + 1, sizeof(offset) );
+      p += length + 9;
+
+      size_t size = type == 'F' ? sizeof(Float_t) : type == 'D' ? sizeof(Double_t) : type == 'B' ? 1 : 0;
+      ok = size > 0 && offset % kSnapshotAlign == 0 && offset <= (unsigned long long)status.st_size
+         && (status.st_size - offset)/size >= nevents;
+      if (!ok) break;
+      const char* data = begin + offset;
+      if      (name == "__weight" && type == 'D') cache->fWeights = (const Double_t*)data;
+      else if (name == "__flags" && type == 'B')  cache->fFlags = (const unsigned char*)data;
+      else if (type == 'F') {
+         cache->fBranches.push_back( TString( name ) );
+         cache->fColumns.push_back( (const Float_t*)data );
+      }
+      else ok = false;
+   }
+   if (!ok || cache->fWeights == 0 || cache->fFlags == 0) {
+      std::cout << "Problem in class \"EventCache\": " << path << " is not a snapshot" << std::endl;
+      delete cache;
+      return 0;
+   }
+   return cache;
+}
+
+//_______________________________________________________________________
+inline bool EventCache::IsInFraction( Long64_t ievt, double fraction )
+{
+   if (fraction >= 1) return true;
+   // a 64 bit multiplicative hash of the event number, as a number in [0,1)
+   unsigned long long hash = (unsigned long long)(ievt + 1) * 0x9E3779B97F4A7C15ULL;
+   return (hash >> 11) * (1.0/9007199254740992.0) < fraction;
+}
+
+//_______________________________________________________________________
+inline bool EventCache::AddToFactory( TMVA::Factory* factory, bool isSignal, const std::vector<TString>& branches,
+                                      ESelection selection, double fraction ) const
+{
+   std::vector<int> columns( branches.size() );
+   for (size_t ivar = 0; ivar < branches.size(); ivar++) {
+      columns[ivar] = GetIndex( branches[ivar] );
+      if (columns[ivar] < 0) {
+         std::cout << "Problem in class \"EventCache\": branch \"" << branches[ivar]
+                   << "\" is not cached for " << fName << std::endl;
+         return false;
+      }
+   }
+
+   std::vector<Double_t> event( columns.size() );
+   for (Long64_t ievt = 0; ievt < GetNEvents(); ievt++) {
+      if (!IsSelected( ievt, selection ) || !IsInFraction( ievt, fraction )) continue;
+      for (size_t ivar = 0; ivar < columns.size(); ivar++) event[ivar] = fColumns[columns[ivar]][ievt];
+      if (isSignal) {
+         if (IsTraining( ievt )) factory->AddSignalTrainingEvent( event, fWeights[ievt] );
+         else                    factory->AddSignalTestEvent( event, fWeights[ievt] );
+      }
+      else {
+         if (IsTraining( ievt )) factory->AddBackgroundTrainingEvent( event, fWeights[ievt] );
+         else                    factory->AddBackgroundTestEvent( event, fWeights[ievt] );
+      }
+   }
+   return true;
+}
+
+#endif
@@ -0,0 +1,90 @@
+// MLPConvergence: early stopping of the MLP trainings, and the cycle a training stopped at
+//
+// TMVA computes the estimator of an MLP on the test events every TestRate cycles.
+// With the options of EarlyStopping, the training stops once that estimator has
+// not improved by more than "improve" in nTests tests in a row, instead of
+// running all NCycles. TMVA keeps the weights of the last cycle, at most
+// nTests*TestRate cycles after the best one, on the plateau.
+//
+// After the training, Read finds in the histogram estimatorHistTest of TMVA.root,
+// the one annconvergencetest.C draws, the cycle the training stopped at and the
+// cycle of the best test estimator.
+//
+//    factory->BookMethod( Types::kMLP, "MLP", "!H:!V:NCycles=600:TestRate=5" + MLPConvergence::EarlyStopping() );
+//    ...
+//    MLPConvergence convergence;
+//    if (convergence.Read( "TMVA.root", "MLP" )) std::cerr << convergence.GetStopCycle() << std::endl;
+
+#ifndef MLPConvergence__def
+#define MLPConvergence__def
+
+#include <sstream>
+#include <iostream>
+
+#include "TFile.h"
+#include "TH1.h"
+#include "TString.h"
+
+class MLPConvergence {
+
+ public:
+
+   MLPConvergence() : fStopCycle( -1 ), fBestCycle( -1 ), fStopEstimator( 0 ), fBestEstimator( 0 ) {}
+
+   // options to append to those of an MLP booking
+   static TString EarlyStopping( int nTests = 10, double improve = 1e-4 );
+
+   // read the test estimator of the MLP "name" from the TMVA output file "path"
+   bool Read( const TString& path, const TString& name );
+
+   int    GetStopCycle() const     { return fStopCycle; }
+   int    GetBestCycle() const     { return fBestCycle; }
+   double GetStopEstimator() const { return fStopEstimator; }
+   double GetBestEstimator() const { return fBestEstimator; }
+
+ private:
+
+   int    fStopCycle;
+   int    fBestCycle;
+   double fStopEstimator;
+   double fBestEstimator;
+};
+
+//_______________________________________________________________________
+inline TString MLPConvergence::EarlyStopping( int nTests, double improve )
+{
+   std::ostringstream options;
+   options << ":ConvergenceTests=" << nTests << ":ConvergenceImprove=" << improve;
+   return options.str().c_str();
+}
+
+//_______________________________________________________________________
+inline bool MLPConvergence::Read( const TString& path, const TString& name )
+{
+   fStopCycle = fBestCycle = -1;
+   TFile* file = TFile::Open( path );
+   TString histName = "Method_MLP/" + name + "/estimatorHistTest";
+   TH1* hist = file ? (TH1*)file->Get( histName ) : 0;
+   if (!hist) {
+      std::cout << "Problem in class \"MLPConvergence\": no " << histName << " in " << path << std::endl;
+      delete file;
+      return false;
+   }
+
+   // one bin per test, centered on its cycle; the bins after the stop stay empty
+   for (int ibin = 1; ibin <= hist->GetNbinsX(); ibin++) {
+      double estimator = hist->GetBinContent( ibin );
+      if (estimator <= 0) continue;
+      fStopCycle     = int( hist->GetBinCenter( ibin ) + 0.5 );
+      fStopEstimator = estimator;
+      if (fBestCycle < 0 || estimator < fBestEstimator) {
+         fBestCycle     = fStopCycle;
+         fBestEstimator = estimator;
+      }
+   }
+   file->Close();
+   delete file;
+   return fStopCycle >= 0;
+}
+
+#endif
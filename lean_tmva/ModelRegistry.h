@@ -0,0 +1,328 @@
+// ModelRegistry: the current version of a scoring model, replaced while it is in use
+//
+// The registry watches a directory, and its subdirectories one level down (the
+// weights/Training_* of run_training_elmu.sh), for files named "fileName". The
+// newest of them, by modification time, is loaded by a ModelLoader on a
+// background thread, once its size and time have not changed for one poll or it
+// is a few seconds old (so that a file still being copied is not loaded), and
+// then becomes the current model in a single pointer swap. A batch takes a
+// reference to the current model with Acquire and gives it back with Release:
+// batches in flight finish on the model they started with, and a replaced model
+// is deleted when its last batch releases it, as with RCU. A version that fails
+// to load is not tried again, and the current model stays.
+//
+//    ScorerLibraryLoader loader( methods, variables );
+//    ModelRegistry registry( "weights", "libTMVAScorer.so", loader );
+//    registry.Start( 10 );                          // poll every 10 s
+//    ...
+//    const ScoringModel* model = registry.Acquire();   // 0 before the first load
+//    model->Score( rows, nEvents, scores );
+//    registry.Release( model );
+
+#ifndef ModelRegistry__def
+#define ModelRegistry__def
+
+#include <vector>
+#include <string>
+#include <set>
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <ctime>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+// a loaded version of the model; it is used by several batches at a time
+class ScoringModel {
+
+ public:
+
+   virtual ~ScoringModel() {}
+
+   // the names of the values of a row, and the number of responses per event
+   virtual const std::vector<std::string>& GetColumns() const = 0;
+   virtual size_t GetNMethods() const = 0;
+
+   // the responses of "nEvents" rows of GetColumns().size() values, of method m in
+   // out[i*GetNMethods() + m]
+   virtual bool Score( const float* rows, size_t nEvents, double* out ) const = 0;
+};
+
+class ModelLoader {
+
+ public:
+
+   virtual ~ModelLoader() {}
+
+   // a new model from the file "path", 0 if it cannot be loaded
+   virtual ScoringModel* Load( const std::string& path ) = 0;
+};
+
+class ModelRegistry {
+
+ public:
+
+   ModelRegistry( const std::string& dir, const std::string& fileName, ModelLoader& loader );
+   ~ModelRegistry();
+
+   // look for a new version now; true if one was swapped in
+   bool Poll();
+
+   // poll every "seconds" on a background thread, until Stop
+   bool Start( double seconds );
+   void Stop();
+
+   // the current model with one more reference, 0 if none is loaded yet; its file
+   // in "path"
+   const ScoringModel* Acquire( std::string* path = 0 );
+   void Release( const ScoringModel* model );
+
+   // the file of the current model
+   std::string GetCurrentPath();
+
+ private:
+
+   ModelRegistry( const ModelRegistry& );
+   ModelRegistry& operator=( const ModelRegistry& );
+
+   struct Version {
+      ScoringModel* model;
+      std::string   path;
+      int           refs;   // the registry's and one per Acquire
+   };
+
+   struct Candidate {
+      std::string path;
+      off_t       size;
+      time_t      mtime;
+      bool operator==( const Candidate& other ) const {
+         return path == other.path && size == other.size && mtime == other.mtime;
+      }
+      bool operator<( const Candidate& other ) const {
+         return path < other.path || (path == other.path && (mtime < other.mtime || (mtime == other.mtime && size < other.size)));
+      }
+   };
+
+   enum { kSettleSeconds = 2 };
+
+   bool FindNewest( Candidate& newest ) const;
+   void Unref( Version* version );
+   static void* RunPolling( void* registry );
+
+   std::string         fDir;
+   std::string         fFileName;
+   ModelLoader&        fLoader;
+
+   pthread_mutex_t       fMutex;     // guards fCurrent, fVersions and the reference counts
+   Version*              fCurrent;
+   std::vector<Version*> fVersions;  // the current one and the replaced ones still acquired
+
+   Candidate           fLoaded;      // of the current model
+   Candidate           fSeen;        // newest at the previous poll
+   std::set<Candidate> fFailed;
+
+   pthread_mutex_t     fPollMutex;   // one poll at a time, and the stop request
+   pthread_cond_t      fStopCondition;
+   pthread_t           fThread;
+   bool                fRunning;
+   bool                fStopping;
+   double              fSeconds;
+};
+
+//_______________________________________________________________________
+inline ModelRegistry::ModelRegistry( const std::string& dir, const std::string& fileName, ModelLoader& loader )
+   : fDir( dir ), fFileName( fileName ), fLoader( loader ), fCurrent( 0 ),
+     fRunning( false ), fStopping( false ), fSeconds( 0 )
+{
+   pthread_mutex_init( &fMutex, 0 );
+   pthread_mutex_init( &fPollMutex, 0 );
+   pthread_cond_init( &fStopCondition, 0 );
+   fLoaded.size = fSeen.size = -1;
+   fLoaded.mtime = fSeen.mtime = 0;
+}
+
+//_______________________________________________________________________
+inline ModelRegistry::~ModelRegistry()
+{
+   Stop();
+   if (fCurrent) Unref( fCurrent );
+   if (!fVersions.empty()) {
+      std::cout << "Problem in class \"ModelRegistry\": " << fVersions.size() << " models are still acquired" << std::endl;
+   }
+   pthread_cond_destroy( &fStopCondition );
+   pthread_mutex_destroy( &fPollMutex );
+   pthread_mutex_destroy( &fMutex );
+}
+
+//_______________________________________________________________________
+inline bool ModelRegistry::FindNewest( Candidate& newest ) const
+{
+   std::vector<std::string> dirs( 1, fDir );
+   DIR* top = opendir( fDir.c_str() );
+   if (top) {
+      struct dirent* entry;
+      while ((entry = readdir( top )) != 0) {
+         std::string name = entry->d_name;
+         struct stat info;
+         if (name == "." || name == "..") continue;
+         if (stat( (fDir + "/" + name).c_str(), &info ) == 0 && S_ISDIR( info.st_mode )) dirs.push_back( fDir + "/" + name );
+      }
+      closedir( top );
+   }
+
+   bool found = false;
+   for (size_t idir = 0; idir < dirs.size(); idir++) {
+      Candidate candidate;
+      candidate.path = dirs[idir] + "/" + fFileName;
+      struct stat info;
+      if (stat( candidate.path.c_str(), &info ) != 0 || !S_ISREG( info.st_mode )) continue;
+      candidate.size  = info.st_size;
+      candidate.mtime = info.st_mtime;
+      if (!found || candidate.mtime > newest.mtime || (candidate.mtime == newest.mtime && candidate.path > newest.path)) {
+         newest = candidate;
+         found  = true;
+      }
+   }
+   return found;
+}
+
+//_______________________________________________________________________
+inline bool ModelRegistry::Poll()
+{
+   pthread_mutex_lock( &fPollMutex );
+   Candidate newest;
+   bool swap = FindNewest( newest ) && !(newest == fLoaded) && fFailed.count( newest ) == 0;
+   // a file is loaded once it did not change since the previous poll, or was
+   // last modified a while ago
+   if (swap && !(newest == fSeen) && time( 0 ) - newest.mtime < kSettleSeconds) {
+      fSeen = newest;
+      swap  = false;
+   }
+   if (!swap) {
+      pthread_mutex_unlock( &fPollMutex );
+      return false;
+   }
+
+   // loaded outside of fMutex, while the batches go on with the current model
+   ScoringModel* model = fLoader.Load( newest.path );
+   if (!model) {
+      std::cout << "Problem in class \"ModelRegistry\": cannot load " << newest.path << ", the current model stays" << std::endl;
+      fFailed.insert( newest );
+      pthread_mutex_unlock( &fPollMutex );
+      return false;
+   }
+   Version* version = new Version;
+   version->model = model;
+   version->path  = newest.path;
+   version->refs  = 1;
+
+   pthread_mutex_lock( &fMutex );
+   Version* old = fCurrent;
+   fCurrent = version;
+   fVersions.push_back( version );
+   pthread_mutex_unlock( &fMutex );
+   fLoaded = newest;
+   std::cout << "--- ModelRegistry: using " << newest.path << std::endl;
+   if (old) Unref( old );
+   pthread_mutex_unlock( &fPollMutex );
+   return true;
+}
+
+//_______________________________________________________________________
+inline const ScoringModel* ModelRegistry::Acquire( std::string* path )
+{
+   pthread_mutex_lock( &fMutex );
+   Version* version = fCurrent;
+   if (version) version->refs++;
+   if (path) *path = version ? version->path : "";
+   pthread_mutex_unlock( &fMutex );
+   return version ? version->model : 0;
+}
+
+//_______________________________________________________________________
+inline void ModelRegistry::Release( const ScoringModel* model )
+{
+   if (!model) return;
+   pthread_mutex_lock( &fMutex );
+   Version* version = 0;
+   for (size_t iversion = 0; iversion < fVersions.size(); iversion++) {
+      if (fVersions[iversion]->model == model) version = fVersions[iversion];
+   }
+   pthread_mutex_unlock( &fMutex );
+   if (version) Unref( version );
+   else std::cout << "Problem in class \"ModelRegistry\": release of a model that was not acquired" << std::endl;
+}
+
+//_______________________________________________________________________
+inline void ModelRegistry::Unref( Version* version )
+{
+   pthread_mutex_lock( &fMutex );
+   bool last = --version->refs == 0;
+   if (last) fVersions.erase( std::find( fVersions.begin(), fVersions.end(), version ) );
+   pthread_mutex_unlock( &fMutex );
+   // the model is deleted outside of the lock, it can take long
+   if (last) {
+      delete version->model;
+      delete version;
+   }
+}
+
+//_______________________________________________________________________
+inline std::string ModelRegistry::GetCurrentPath()
+{
+   pthread_mutex_lock( &fMutex );
+   std::string path = fCurrent ? fCurrent->path : "";
+   pthread_mutex_unlock( &fMutex );
+   return path;
+}
+
+//_______________________________________________________________________
+inline bool ModelRegistry::Start( double seconds )
+{
+   if (fRunning) return true;
+   fSeconds  = seconds > 0 ? seconds : 1;
+   fStopping = false;
+   fRunning  = pthread_create( &fThread, 0, RunPolling, this ) == 0;
+   if (!fRunning) std::cout << "Problem in class \"ModelRegistry\": cannot start the polling thread" << std::endl;
+   return fRunning;
+}
+
+//_______________________________________________________________________
+inline void ModelRegistry::Stop()
+{
+   if (!fRunning) return;
+   pthread_mutex_lock( &fPollMutex );
+   fStopping = true;
+   pthread_cond_signal( &fStopCondition );
+   pthread_mutex_unlock( &fPollMutex );
+   pthread_join( fThread, 0 );
+   fRunning = false;
+}
+
+//_______________________________________________________________________
+inline void* ModelRegistry::RunPolling( void* p )
+{
+   ModelRegistry& registry = *(ModelRegistry*)p;
+   for (;;) {
+      registry.Poll();
+
+      struct timeval now;
+      gettimeofday( &now, 0 );
+      double wake = now.tv_sec + 1e-6*now.tv_usec + registry.fSeconds;
+      struct timespec until;
+      until.tv_sec  = time_t( wake );
+      until.tv_nsec = long( (wake - until.tv_sec)*1e9 );
+      pthread_mutex_lock( &registry.fPollMutex );
+      while (!registry.fStopping) {
+         if (pthread_cond_timedwait( &registry.fStopCondition, &registry.fPollMutex, &until ) == ETIMEDOUT) break;
+      }
+      bool stopping = registry.fStopping;
+      pthread_mutex_unlock( &registry.fPollMutex );
+      if (stopping) break;
+   }
+   return 0;
+}
+
+#endif
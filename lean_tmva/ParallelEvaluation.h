@@ -0,0 +1,428 @@
+// ParallelEvaluation: scores the sample trees of a driver on a pool of worker processes
+//
+// The samples are split into jobs of consecutive entries, and job j is evaluated by
+// worker j % nWorkers. The workers are forked copies of the driver, so each has its
+// own TMVA::Reader and branch buffers (ROOT 5 I/O and TMVA are not thread safe); a
+// worker reopens the files of its samples, since file descriptors inherited from
+// the driver share their offset with it. Every job is filled into its own empty
+// SignificanceScans, sent back through a pipe, and the driver adds the jobs in job
+// order: the result does not depend on the number of workers or on their timing.
+// Samples can also be EventCaches, which the workers read from their copy of memory.
+//
+//    ReaderEvaluator evaluator( reader, var_val, backgroundBranches, signalBranches );
+//    evaluator.AddMethod( "MLP method", 0 );
+//    ParallelEvaluation evaluation;
+//    evaluation.AddSample( ttbar_el, false );
+//    evaluation.AddSample( signal_test_el, true );
+//    evaluation.Run( evaluator, scans );   // scans[0] holds the MLP response
+
+#ifndef ParallelEvaluation__def
+#define ParallelEvaluation__def
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TString.h"
+#include "TMVA/Reader.h"
+
+#include "SignificanceScan.h"
+#include "EventCache.h"
+
+class SampleEvaluator {
+
+ public:
+
+   virtual ~SampleEvaluator() {}
+
+   // fill the entries first, ..., last-1 of a sample tree into scans; false if the
+   // sample lacks an input, which fails the evaluation
+   virtual bool Evaluate( TTree* tree, bool isSignal, Long64_t first, Long64_t last,
+                          std::vector<SignificanceScan>& scans ) = 0;
+
+   // the same for the events first, ..., last-1 of a cached sample
+   virtual bool Evaluate( const EventCache& cache, bool isSignal, Long64_t first, Long64_t last,
+                          std::vector<SignificanceScan>& scans ) = 0;
+};
+
+// evaluates TMVA::Reader methods on the mini trees: events with analysis_channel 0
+// are skipped, the others have the weight weight_1btin_70*weight_70/btweight_70
+class ReaderEvaluator : public SampleEvaluator {
+
+ public:
+
+   // "values" are the variables given to reader->AddVariable, read from the
+   // branches "backgroundBranches" of background and "signalBranches" of signal trees
+   ReaderEvaluator( TMVA::Reader* reader, std::vector<Float_t>& values,
+                    const std::vector<TString>& backgroundBranches,
+                    const std::vector<TString>& signalBranches )
+      : fReader( reader ), fValues( values ),
+        fBackgroundBranches( backgroundBranches ), fSignalBranches( signalBranches ) {}
+
+   // fill scale*response + offset of method "name" into scans[iscan]
+   void AddMethod( const TString& name, int iscan, double scale = 1, double offset = 0 )
+   {
+      fMethods.push_back( name );
+      fScans.push_back( iscan );
+      fScales.push_back( scale );
+      fOffsets.push_back( offset );
+   }
+
+   bool Evaluate( TTree* tree, bool isSignal, Long64_t first, Long64_t last,
+                  std::vector<SignificanceScan>& scans );
+   bool Evaluate( const EventCache& cache, bool isSignal, Long64_t first, Long64_t last,
+                  std::vector<SignificanceScan>& scans );
+
+ private:
+
+   void Fill( bool isSignal, Double_t weight, std::vector<SignificanceScan>& scans );
+
+   TMVA::Reader*         fReader;
+   std::vector<Float_t>& fValues;
+   std::vector<TString>  fBackgroundBranches;
+   std::vector<TString>  fSignalBranches;
+   std::vector<TString>  fMethods;
+   std::vector<int>      fScans;
+   std::vector<double>   fScales;
+   std::vector<double>   fOffsets;
+};
+
+class ParallelEvaluation {
+
+ public:
+
+   // nWorkers 0 is one worker per online processor
+   ParallelEvaluation( int nWorkers = 0, Long64_t nEntriesPerJob = 100000 )
+      : fNWorkers( nWorkers > 0 ? nWorkers : int(sysconf( _SC_NPROCESSORS_ONLN )) ),
+        fNEntriesPerJob( nEntriesPerJob ) {}
+
+   void AddSample( TTree* tree, bool isSignal )
+   {
+      fSamples.push_back( tree );
+      fCaches.push_back( 0 );
+      fIsSignal.push_back( isSignal );
+   }
+
+   // the cache must outlive the evaluation
+   void AddSample( const EventCache* cache, bool isSignal )
+   {
+      fSamples.push_back( 0 );
+      fCaches.push_back( cache );
+      fIsSignal.push_back( isSignal );
+   }
+
+   // add the events of all samples to "scans"; returns false if a worker failed,
+   // in which case "scans" are unchanged
+   bool Run( SampleEvaluator& evaluator, std::vector<SignificanceScan>& scans ) const;
+
+ private:
+
+   struct Job {
+      int      sample;
+      Long64_t first;
+      Long64_t last;
+   };
+
+   bool EvaluateJob( const Job& job, TTree* tree, SampleEvaluator& evaluator,
+                     std::vector<SignificanceScan>& scans ) const;
+   bool RunWorker( int iworker, int nworkers, const std::vector<Job>& jobs,
+                   SampleEvaluator& evaluator, const std::vector<SignificanceScan>& empty,
+                   int fd ) const;
+
+   static bool WriteAll( int fd, const void* buffer, size_t size );
+
+   int                 fNWorkers;
+   Long64_t            fNEntriesPerJob;
+   std::vector<TTree*>            fSamples;
+   std::vector<const EventCache*> fCaches;
+   std::vector<bool>              fIsSignal;
+};
+
+//_______________________________________________________________________
+inline bool ReaderEvaluator::Evaluate( TTree* tree, bool isSignal, Long64_t first, Long64_t last,
+                                       std::vector<SignificanceScan>& scans )
+{
+   Float_t weight_70, btweight_70, weight_1btin_70;
+   Int_t analysis_channel;
+
+   const std::vector<TString>& branches = isSignal ? fSignalBranches : fBackgroundBranches;
+   for (size_t ivar = 0; ivar < branches.size(); ivar++) {
+      if (tree->GetBranch( branches[ivar] ) == 0) {
+         std::cout << "Problem in class \"ReaderEvaluator\": no branch \"" << branches[ivar]
+                   << "\" in " << tree->GetName() << std::endl;
+         tree->ResetBranchAddresses();
+         return false;
+      }
+      tree->SetBranchAddress( branches[ivar], &fValues[ivar] );
+   }
+   tree->SetBranchAddress( "weight_70", &weight_70 );
+   tree->SetBranchAddress( "btweight_70", &btweight_70 );
+   tree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70 );
+   tree->SetBranchAddress( "analysis_channel", &analysis_channel );
+
+   for (Long64_t ievt = first; ievt < last; ievt++) {
+      tree->GetEntry( ievt );
+      if (analysis_channel == 0) continue;
+
+      Fill( isSignal, weight_1btin_70*weight_70/btweight_70, scans );
+   }
+
+   tree->ResetBranchAddresses();
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool ReaderEvaluator::Evaluate( const EventCache& cache, bool isSignal, Long64_t first, Long64_t last,
+                                       std::vector<SignificanceScan>& scans )
+{
+   const std::vector<TString>& branches = isSignal ? fSignalBranches : fBackgroundBranches;
+   std::vector<const Float_t*> columns( branches.size() );
+   for (size_t ivar = 0; ivar < branches.size(); ivar++) {
+      int icolumn = cache.GetIndex( branches[ivar] );
+      if (icolumn < 0) {
+         std::cout << "Problem in class \"ReaderEvaluator\": branch \"" << branches[ivar]
+                   << "\" is not cached for " << cache.GetName() << std::endl;
+         return false;
+      }
+      columns[ivar] = cache.GetColumn( icolumn );
+   }
+
+   for (Long64_t ievt = first; ievt < last; ievt++) {
+      for (size_t ivar = 0; ivar < columns.size(); ivar++) fValues[ivar] = columns[ivar][ievt];
+      Fill( isSignal, cache.GetWeight( ievt ), scans );
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline void ReaderEvaluator::Fill( bool isSignal, Double_t weight, std::vector<SignificanceScan>& scans )
+{
+   for (size_t imethod = 0; imethod < fMethods.size(); imethod++) {
+      double mva = fScales[imethod]*fReader->EvaluateMVA( fMethods[imethod] ) + fOffsets[imethod];
+      if (isSignal) scans[fScans[imethod]].FillSignal( mva, weight );
+      else          scans[fScans[imethod]].FillBackground( mva, weight );
+   }
+}
+
+//_______________________________________________________________________
+inline bool ParallelEvaluation::Run( SampleEvaluator& evaluator, std::vector<SignificanceScan>& scans ) const
+{
+   std::vector<Job> jobs;
+   for (size_t isample = 0; isample < fSamples.size(); isample++) {
+      Long64_t nentries = fCaches[isample] ? fCaches[isample]->GetNEvents() : fSamples[isample]->GetEntries();
+      for (Long64_t first = 0; first < nentries; first += fNEntriesPerJob) {
+         Job job;
+         job.sample = isample;
+         job.first  = first;
+         job.last   = first + fNEntriesPerJob < nentries ? first + fNEntriesPerJob : nentries;
+         jobs.push_back( job );
+      }
+   }
+
+   std::vector<SignificanceScan> empty( scans );
+   size_t ncontents = 0;
+   for (size_t iscan = 0; iscan < empty.size(); iscan++) {
+      empty[iscan].Reset();
+      ncontents += empty[iscan].GetNContents();
+   }
+
+   // contents of the scans of each job, in the order of "scans"
+   std::vector<std::vector<double> > results( jobs.size() );
+
+   int nworkers = fNWorkers < int(jobs.size()) ? fNWorkers : int(jobs.size());
+   if (nworkers <= 1) {
+      for (size_t ijob = 0; ijob < jobs.size(); ijob++) {
+         std::vector<SignificanceScan> jobScans( empty );
+         if (!EvaluateJob( jobs[ijob], fSamples[jobs[ijob].sample], evaluator, jobScans )) return false;
+         for (size_t iscan = 0; iscan < jobScans.size(); iscan++) {
+            std::vector<double> contents = jobScans[iscan].GetContents();
+            results[ijob].insert( results[ijob].end(), contents.begin(), contents.end() );
+         }
+      }
+   }
+   else {
+      // buffered output would otherwise be written by every worker as well
+      std::cout.flush();
+      std::cerr.flush();
+      fflush( 0 );
+
+      bool ok = true;
+      std::vector<pid_t> pids;
+      std::vector<int>   fds;
+      for (int iworker = 0; iworker < nworkers; iworker++) {
+         int fd[2];
+         pid_t pid = -1;
+         if (pipe( fd ) == 0) {
+            pid = fork();
+            if (pid < 0) {
+               close( fd[0] );
+               close( fd[1] );
+            }
+         }
+         if (pid < 0) {
+            std::cout << "Problem in class \"ParallelEvaluation\": cannot start worker " << iworker << std::endl;
+            ok = false;
+            break;
+         }
+         if (pid == 0) {
+            close( fd[0] );
+            bool ok = RunWorker( iworker, nworkers, jobs, evaluator, empty, fd[1] );
+            close( fd[1] );
+            _exit( ok ? 0 : 1 );
+         }
+         close( fd[1] );
+         pids.push_back( pid );
+         fds.push_back( fd[0] );
+      }
+
+      // the pipes are drained together: a worker whose results do not fit in its
+      // pipe would otherwise wait on the workers read before it
+      const size_t message = sizeof(int) + ncontents*sizeof(double);
+      std::vector<std::vector<char> > received( fds.size() );
+      std::vector<struct pollfd> pending;
+      for (size_t iworker = 0; iworker < fds.size(); iworker++) {
+         struct pollfd pfd;
+         pfd.fd      = fds[iworker];
+         pfd.events  = POLLIN;
+         pfd.revents = 0;
+         pending.push_back( pfd );
+      }
+      std::vector<char> chunk( 1 << 16 );
+      while (!pending.empty()) {
+         if (poll( &pending[0], pending.size(), -1 ) < 0) {
+            if (errno == EINTR) continue;
+            std::cout << "Problem in class \"ParallelEvaluation\": cannot wait for the workers" << std::endl;
+            for (size_t iworker = 0; iworker < pids.size(); iworker++) kill( pids[iworker], SIGKILL );
+            ok = false;
+            break;
+         }
+         for (size_t ipending = pending.size(); ipending-- > 0; ) {
+            if (pending[ipending].revents == 0) continue;
+            size_t iworker = std::find( fds.begin(), fds.end(), pending[ipending].fd ) - fds.begin();
+            ssize_t n = read( pending[ipending].fd, &chunk[0], chunk.size() );
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+               pending.erase( pending.begin() + ipending );
+               continue;
+            }
+            std::vector<char>& buffer = received[iworker];
+            buffer.insert( buffer.end(), chunk.begin(), chunk.begin() + n );
+            size_t used = 0;
+            for (; buffer.size() - used >= message; used += message) {
+               int ijob;
+               memcpy( &ijob, &buffer[used], sizeof(ijob) );
+               if (ijob < 0 || ijob >= int(jobs.size())) continue;
+               results[ijob].resize( ncontents );
+               memcpy( &results[ijob][0], &buffer[used + sizeof(ijob)], ncontents*sizeof(double) );
+            }
+            buffer.erase( buffer.begin(), buffer.begin() + used );
+         }
+      }
+
+      for (size_t iworker = 0; iworker < fds.size(); iworker++) {
+         close( fds[iworker] );
+         int status;
+         if (waitpid( pids[iworker], &status, 0 ) < 0 || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0) {
+            std::cout << "Problem in class \"ParallelEvaluation\": worker " << iworker << " failed" << std::endl;
+            ok = false;
+         }
+      }
+      if (!ok) return false;
+   }
+
+   for (size_t ijob = 0; ijob < jobs.size(); ijob++) {
+      if (results[ijob].size() != ncontents) {
+         int isample = jobs[ijob].sample;
+         std::cout << "Problem in class \"ParallelEvaluation\": no result for entries " << jobs[ijob].first
+                   << " to " << jobs[ijob].last << " of "
+                   << (fCaches[isample] ? fCaches[isample]->GetName().Data() : fSamples[isample]->GetName()) << std::endl;
+         return false;
+      }
+   }
+   for (size_t ijob = 0; ijob < jobs.size(); ijob++) {
+      const double* contents = &results[ijob][0];
+      for (size_t iscan = 0; iscan < scans.size(); iscan++) {
+         scans[iscan].AddContents( contents );
+         contents += scans[iscan].GetNContents();
+      }
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool ParallelEvaluation::EvaluateJob( const Job& job, TTree* tree, SampleEvaluator& evaluator,
+                                             std::vector<SignificanceScan>& scans ) const
+{
+   const EventCache* cache = fCaches[job.sample];
+   if (cache) return evaluator.Evaluate( *cache, fIsSignal[job.sample], job.first, job.last, scans );
+   return evaluator.Evaluate( tree, fIsSignal[job.sample], job.first, job.last, scans );
+}
+
+//_______________________________________________________________________
+inline bool ParallelEvaluation::RunWorker( int iworker, int nworkers, const std::vector<Job>& jobs,
+                                           SampleEvaluator& evaluator, const std::vector<SignificanceScan>& empty,
+                                           int fd ) const
+{
+   std::vector<TFile*> files( fSamples.size(), 0 );
+   std::vector<TTree*> trees( fSamples.size(), 0 );
+   bool ok = true;
+   for (size_t ijob = iworker; ok && ijob < jobs.size(); ijob += nworkers) {
+      int isample = jobs[ijob].sample;
+      if (fSamples[isample] && trees[isample] == 0) {
+         TFile* current = fSamples[isample]->GetCurrentFile();
+         if (current) files[isample] = TFile::Open( current->GetName(), "READ" );
+         if (files[isample]) trees[isample] = (TTree*)files[isample]->Get( fSamples[isample]->GetName() );
+         if (trees[isample] == 0) {
+            std::cout << "Problem in class \"ParallelEvaluation\": cannot reopen tree \""
+                      << fSamples[isample]->GetName() << "\" of "
+                      << (current ? current->GetName() : "a tree without file") << std::endl;
+            ok = false;
+            break;
+         }
+      }
+
+      std::vector<SignificanceScan> jobScans( empty );
+      if (!EvaluateJob( jobs[ijob], trees[isample], evaluator, jobScans )) {
+         ok = false;
+         break;
+      }
+
+      int job = ijob;
+      ok = WriteAll( fd, &job, sizeof(job) );
+      for (size_t iscan = 0; ok && iscan < jobScans.size(); iscan++) {
+         std::vector<double> contents = jobScans[iscan].GetContents();
+         ok = WriteAll( fd, &contents[0], contents.size()*sizeof(double) );
+      }
+   }
+   for (size_t isample = 0; isample < files.size(); isample++) {
+      if (files[isample]) files[isample]->Close();
+   }
+   std::cout.flush();
+   return ok;
+}
+
+//_______________________________________________________________________
+inline bool ParallelEvaluation::WriteAll( int fd, const void* buffer, size_t size )
+{
+   const char* p = (const char*)buffer;
+   while (size > 0) {
+      ssize_t n = write( fd, p, size );
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= n;
+   }
+   return true;
+}
+
+#endif
@@ -0,0 +1,149 @@
+// ParallelScorer: scores a batch of events with a FusedScorer on several threads
+//
+// The events are split into as many contiguous ranges as there are threads, and
+// each thread scores its range in blocks, into its own part of the output: the
+// result does not depend on the number of threads. The generated readers keep no
+// state while scoring, so one FusedScorer is shared by all threads. Unlike the
+// drivers (see ParallelEvaluation.h), nothing here touches ROOT, so threads are
+// used instead of forked workers.
+//
+//    ParallelScorer parallel( scorer, nThreads );
+//    parallel.Score( input, input.GetIndices( columns ), &scores[0] );   // from a ColumnInput
+//    parallel.Score( rows, nEvents, stride, &scores[0] );                // from rows in memory
+
+#ifndef ParallelScorer__def
+#define ParallelScorer__def
+
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "FusedScorer.h"
+#include "ColumnInput.h"
+
+class ParallelScorer {
+
+ public:
+
+   // nThreads 0 is one thread per online processor
+   ParallelScorer( const FusedScorer& scorer, int nThreads = 0 )
+      : fScorer( scorer ), fNThreads( nThreads > 0 ? nThreads : int(sysconf( _SC_NPROCESSORS_ONLN )) ) {}
+
+   // as FusedScorer::Score
+   bool Score( const float* rows, size_t nEvents, size_t stride, double* out ) const;
+
+   // the events of "input", with the values of "columns", one per column of the scorer
+   bool Score( const ColumnInput& input, const std::vector<int>& columns, double* out ) const;
+
+ private:
+
+   // the events first, ..., last-1 of one thread
+   struct Job {
+      const ParallelScorer* scorer;
+      const float*          rows;
+      size_t                stride;
+      const ColumnInput*    input;
+      std::vector<int>      columns;
+      size_t                first, last;
+      double*               out;
+   };
+
+   bool Run( const Job& all, size_t nEvents ) const;
+   static void* RunJob( void* job );
+
+   const FusedScorer& fScorer;
+   int                fNThreads;
+};
+
+//_______________________________________________________________________
+inline bool ParallelScorer::Score( const float* rows, size_t nEvents, size_t stride, double* out ) const
+{
+   Job all;
+   all.scorer = this;
+   all.rows   = rows;
+   all.stride = stride;
+   all.input  = 0;
+   all.out    = out;
+   return Run( all, nEvents );
+}
+
+//_______________________________________________________________________
+inline bool ParallelScorer::Score( const ColumnInput& input, const std::vector<int>& columns, double* out ) const
+{
+   for (size_t j = 0; j < columns.size(); j++) {
+      if (columns[j] < 0 || columns[j] >= (int)input.GetNColumns()) {
+         std::cout << "Problem in class \"ParallelScorer\": column " << j << " of the scorer is not in the input" << std::endl;
+         return false;
+      }
+   }
+   Job all;
+   all.scorer  = this;
+   all.rows    = 0;
+   all.stride  = columns.size();
+   all.input   = &input;
+   all.columns = columns;
+   all.out     = out;
+   return Run( all, input.GetNEvents() );
+}
+
+//_______________________________________________________________________
+inline bool ParallelScorer::Run( const Job& all, size_t nEvents ) const
+{
+   if (nEvents == 0 || fScorer.GetNMethods() == 0) return true;
+
+   // at least a few blocks per thread, or the threads cost more than they save
+   const size_t nMin = 4096;
+   size_t nthreads = fNThreads;
+   if (nthreads > (nEvents + nMin - 1)/nMin) nthreads = (nEvents + nMin - 1)/nMin;
+   if (nthreads < 1) nthreads = 1;
+
+   std::vector<Job> jobs( nthreads, all );
+   for (size_t ithread = 0; ithread < nthreads; ithread++) {
+      jobs[ithread].first = nEvents*ithread/nthreads;
+      jobs[ithread].last  = nEvents*(ithread + 1)/nthreads;
+   }
+   if (nthreads == 1) {
+      RunJob( &jobs[0] );
+      return true;
+   }
+
+   bool ok = true;
+   std::vector<pthread_t> threads( nthreads );
+   std::vector<bool>      started( nthreads, false );
+   for (size_t ithread = 1; ithread < nthreads; ithread++) {
+      started[ithread] = pthread_create( &threads[ithread], 0, RunJob, &jobs[ithread] ) == 0;
+   }
+   // the calling thread takes the first range, and the ranges of threads that did not start
+   RunJob( &jobs[0] );
+   for (size_t ithread = 1; ithread < nthreads; ithread++) {
+      if (started[ithread]) ok = pthread_join( threads[ithread], 0 ) == 0 && ok;
+      else RunJob( &jobs[ithread] );
+   }
+   if (!ok) std::cout << "Problem in class \"ParallelScorer\": a thread failed" << std::endl;
+   return ok;
+}
+
+//_______________________________________________________________________
+inline void* ParallelScorer::RunJob( void* p )
+{
+   const Job& job = *(const Job*)p;
+   const FusedScorer& scorer = job.scorer->fScorer;
+   const size_t nMethods = scorer.GetNMethods();
+   const size_t nBlock = 1024;
+   std::vector<float> rows;
+   if (job.input) rows.resize( nBlock*job.stride );
+   for (size_t first = job.first; first < job.last; first += nBlock) {
+      size_t n = job.last - first < nBlock ? job.last - first : nBlock;
+      if (job.input) {
+         job.input->GetRows( job.columns, first, n, &rows[0] );
+         scorer.Score( &rows[0], n, job.stride, job.out + first*nMethods );
+      }
+      else {
+         scorer.Score( job.rows + first*job.stride, n, job.stride, job.out + first*nMethods );
+      }
+   }
+   return 0;
+}
+
+#endif
@@ -0,0 +1,163 @@
+// ScorerLibrary: a ScoringModel in a libTMVAScorer.so, loaded with dlopen
+//
+// The library is a build of compile_scorer.sh, whose generated readers are the
+// model: a retraining is deployed by building the scorer from the new class files
+// and copying the library into the watched directory (see ModelRegistry.h). The
+// library is copied to a private file before dlopen, so that a library replaced
+// in place is loaded again rather than found already open, and several versions
+// can be loaded at the same time. The methods and their input variables are
+// given by the loader; a version whose readers do not accept them is not loaded.
+//
+//    ScorerLibraryLoader loader( methods, variables );     // methods[m] reads variables[m]
+//    ScoringModel* model = loader.Load( "weights/Training_elmu_00/libTMVAScorer.so" );
+
+#ifndef ScorerLibrary__def
+#define ScorerLibrary__def
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include "ModelRegistry.h"
+#include "TMVAScorer.h"
+
+class ScorerLibrary : public ScoringModel {
+
+ public:
+
+   ~ScorerLibrary();
+
+   const std::vector<std::string>& GetColumns() const { return fColumns; }
+   size_t GetNMethods() const { return fNMethods; }
+   bool Score( const float* rows, size_t nEvents, double* out ) const;
+
+ private:
+
+   friend class ScorerLibraryLoader;
+
+   ScorerLibrary() : fHandle( 0 ), fScorer( 0 ), fNMethods( 0 ), fNThreads( 0 ),
+                     fScore( 0 ), fDestroy( 0 ) {}
+
+   typedef int  (*ScoreFunction)( const TMVAScorer*, const float*, size_t, int, double* );
+   typedef void (*DestroyFunction)( TMVAScorer* );
+
+   void*                    fHandle;
+   TMVAScorer*              fScorer;
+   std::vector<std::string> fColumns;
+   size_t                   fNMethods;
+   int                      fNThreads;
+   ScoreFunction            fScore;
+   DestroyFunction          fDestroy;
+};
+
+class ScorerLibraryLoader : public ModelLoader {
+
+ public:
+
+   // methods[m] on the input variables variables[m]; scoring on nThreads threads
+   ScorerLibraryLoader( const std::vector<std::string>& methods,
+                        const std::vector<std::vector<std::string> >& variables, int nThreads = 0 );
+
+   ScoringModel* Load( const std::string& path );
+
+ private:
+
+   std::vector<std::string>               fMethods;
+   std::vector<std::vector<std::string> > fVariables;
+   std::vector<std::string>               fColumns;   // the union of the variables
+   int                                    fNThreads;
+   int                                    fNLoaded;
+};
+
+//_______________________________________________________________________
+inline ScorerLibrary::~ScorerLibrary()
+{
+   if (fScorer && fDestroy) fDestroy( fScorer );
+   if (fHandle) dlclose( fHandle );
+}
+
+//_______________________________________________________________________
+inline bool ScorerLibrary::Score( const float* rows, size_t nEvents, double* out ) const
+{
+   return fScore( fScorer, rows, nEvents, fNThreads, out ) == 0;
+}
+
+//_______________________________________________________________________
+inline ScorerLibraryLoader::ScorerLibraryLoader( const std::vector<std::string>& methods,
+                                                 const std::vector<std::vector<std::string> >& variables, int nThreads )
+   : fMethods( methods ), fVariables( variables ), fNThreads( nThreads ), fNLoaded( 0 )
+{
+   for (size_t m = 0; m < fVariables.size(); m++) {
+      for (size_t v = 0; v < fVariables[m].size(); v++) {
+         if (std::find( fColumns.begin(), fColumns.end(), fVariables[m][v] ) == fColumns.end()) fColumns.push_back( fVariables[m][v] );
+      }
+   }
+}
+
+//_______________________________________________________________________
+inline ScoringModel* ScorerLibraryLoader::Load( const std::string& path )
+{
+   // the private copy is removed once it is open, the mapping stays
+   std::ostringstream copy;
+   const char* tmp = getenv( "TMPDIR" );
+   copy << (tmp ? tmp : "/tmp") << "/libTMVAScorer-" << getpid() << "-" << fNLoaded++ << ".so";
+   {
+      std::ifstream in( path.c_str(), std::ios::binary );
+      std::ofstream out( copy.str().c_str(), std::ios::binary );
+      if (in && out) out << in.rdbuf();
+      out.close();
+      if (!in || !out) {
+         std::cout << "Problem in class \"ScorerLibraryLoader\": cannot copy " << path << " to " << copy.str() << std::endl;
+         unlink( copy.str().c_str() );
+         return 0;
+      }
+   }
+   void* handle = dlopen( copy.str().c_str(), RTLD_NOW | RTLD_LOCAL );
+   unlink( copy.str().c_str() );
+   if (!handle) {
+      std::cout << "Problem in class \"ScorerLibraryLoader\": cannot open " << path << ": " << dlerror() << std::endl;
+      return 0;
+   }
+
+   ScorerLibrary* library = new ScorerLibrary;
+   library->fHandle   = handle;
+   library->fColumns  = fColumns;
+   library->fNThreads = fNThreads;
+   typedef TMVAScorer* (*CreateFunction)( int, const char* const* );
+   typedef int (*AddFunction)( TMVAScorer*, const char*, int, const char* const* );
+   CreateFunction create = (CreateFunction)dlsym( handle, "tmva_scorer_create" );
+   AddFunction    add    = (AddFunction)dlsym( handle, "tmva_scorer_add_method" );
+   library->fScore       = (ScorerLibrary::ScoreFunction)dlsym( handle, "tmva_scorer_score" );
+   library->fDestroy     = (ScorerLibrary::DestroyFunction)dlsym( handle, "tmva_scorer_destroy" );
+   if (!create || !add || !library->fScore || !library->fDestroy) {
+      std::cout << "Problem in class \"ScorerLibraryLoader\": " << path << " is not a libTMVAScorer" << std::endl;
+      delete library;
+      return 0;
+   }
+
+   std::vector<const char*> columns;
+   for (size_t c = 0; c < fColumns.size(); c++) columns.push_back( fColumns[c].c_str() );
+   library->fScorer = columns.empty() ? 0 : create( columns.size(), &columns[0] );
+   bool ok = library->fScorer != 0;
+   for (size_t m = 0; ok && m < fMethods.size(); m++) {
+      std::vector<const char*> vars;
+      for (size_t v = 0; v < fVariables[m].size(); v++) vars.push_back( fVariables[m][v].c_str() );
+      ok = !vars.empty() && add( library->fScorer, fMethods[m].c_str(), vars.size(), &vars[0] ) == 0;
+      library->fNMethods += ok;
+   }
+   if (!ok) {
+      std::cout << "Problem in class \"ScorerLibraryLoader\": the methods of " << path << " do not accept the variables" << std::endl;
+      delete library;
+      return 0;
+   }
+   return library;
+}
+
+#endif
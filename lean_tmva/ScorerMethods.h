@@ -0,0 +1,110 @@
+// ScorerMethods: the generated readers compiled into the ROOT-free scorer
+//
+// The readers of weights/TMVAClassification_*.class.C need no ROOT, but their
+// files are large (the BDTG one has 170k lines of trees), so a scorer is built
+// with the methods it needs only, each selected by a macro SCORER_<method>. With
+// SCORER_<method>_FOREST the BDT or BDTG is the Read<method>Forest of
+// generate_forest.py, whose node tables are static and cost nothing to construct;
+// its weights/TMVAClassification_<method>.forest_*.C must then be linked in.
+//
+//    g++ -DSCORER_MLP -DSCORER_BDTG -DSCORER_BDTG_FOREST TMVAScorer.cxx weights/TMVAClassification_BDTG.forest_*.C
+//    ...
+//    IClassifierReader* reader = MakeScorerReader( "MLP", inputVars );   // 0 if not compiled in
+//
+// compile_scorer.sh sets the macros from the names of the methods.
+
+#ifndef ScorerMethods__def
+#define ScorerMethods__def
+
+#include <vector>
+#include <string>
+
+#ifdef SCORER_MLP
+#include "weights/TMVAClassification_MLP.class.C"
+#endif
+#ifdef SCORER_Fisher
+#include "weights/TMVAClassification_Fisher.class.C"
+#endif
+#ifdef SCORER_LD
+#include "weights/TMVAClassification_LD.class.C"
+#endif
+#ifdef SCORER_RuleFit
+#include "weights/TMVAClassification_RuleFit.class.C"
+#endif
+#ifdef SCORER_BDT
+#ifdef SCORER_BDT_FOREST
+#include "weights/TMVAClassification_BDT.forest.h"
+#else
+#include "weights/TMVAClassification_BDT.class.C"
+#endif
+#endif
+#ifdef SCORER_BDTG
+#ifdef SCORER_BDTG_FOREST
+#include "weights/TMVAClassification_BDTG.forest.h"
+#else
+#include "weights/TMVAClassification_BDTG.class.C"
+#endif
+#endif
+
+#include "FusedScorer.h"
+
+// the names of the methods compiled in
+inline std::vector<std::string> GetScorerMethods()
+{
+   std::vector<std::string> methods;
+#ifdef SCORER_MLP
+   methods.push_back( "MLP" );
+#endif
+#ifdef SCORER_Fisher
+   methods.push_back( "Fisher" );
+#endif
+#ifdef SCORER_LD
+   methods.push_back( "LD" );
+#endif
+#ifdef SCORER_RuleFit
+   methods.push_back( "RuleFit" );
+#endif
+#ifdef SCORER_BDT
+   methods.push_back( "BDT" );
+#endif
+#ifdef SCORER_BDTG
+   methods.push_back( "BDTG" );
+#endif
+   return methods;
+}
+
+// a new reader of "method" for the input variables "inputVars", 0 if the method is
+// not compiled in; the reader checks the variables, see IsStatusClean
+inline IClassifierReader* MakeScorerReader( const std::string& method, std::vector<std::string>& inputVars )
+{
+#ifdef SCORER_MLP
+   if (method == "MLP") return new ReadMLP( inputVars );
+#endif
+#ifdef SCORER_Fisher
+   if (method == "Fisher") return new ReadFisher( inputVars );
+#endif
+#ifdef SCORER_LD
+   if (method == "LD") return new ReadLD( inputVars );
+#endif
+#ifdef SCORER_RuleFit
+   if (method == "RuleFit") return new ReadRuleFit( inputVars );
+#endif
+#ifdef SCORER_BDT
+#ifdef SCORER_BDT_FOREST
+   if (method == "BDT") return new ReadBDTForest( inputVars );
+#else
+   if (method == "BDT") return new ReadBDT( inputVars );
+#endif
+#endif
+#ifdef SCORER_BDTG
+#ifdef SCORER_BDTG_FOREST
+   if (method == "BDTG") return new ReadBDTGForest( inputVars );
+#else
+   if (method == "BDTG") return new ReadBDTG( inputVars );
+#endif
+#endif
+   (void)inputVars;
+   return 0;
+}
+
+#endif
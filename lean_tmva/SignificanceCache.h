@@ -0,0 +1,138 @@
+// SignificanceCache: persistent results of trainings, so that a training done before is not repeated
+//
+// A training is identified by a key, a 64 bit hash of everything its result depends
+// on: the variables, the method with its options and significance scan, and the
+// samples with their selection and training split, each sample by a hash of its
+// weights and variable columns (see EventCache::GetFingerprint). The file of the
+// cache holds one line per training,
+//
+//    <key> <method> <significance> <best cut>
+//
+// appended in a single write, so that concurrent trials (see SubsetSearch.h) can
+// share it. Find reads the lines appended since the last look, so a trial also
+// sees the results of trials that finished after the cache was opened.
+//
+//    SignificanceCache cache( "significances.txt" );
+//    std::string key = SignificanceCache::MakeKey( description );
+//    if (!cache.Find( key, significance, cut )) {
+//       ... train and evaluate ...
+//       cache.Store( key, "MLP", significance, cut );
+//    }
+
+#ifndef SignificanceCache__def
+#define SignificanceCache__def
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "TString.h"
+
+class SignificanceCache {
+
+ public:
+
+   // a relative path is taken from the current directory, not from the
+   // directory a trial later runs in
+   SignificanceCache( const TString& path );
+
+   // key of the training described by "description"
+   static std::string MakeKey( const std::string& description );
+
+   bool Find( const std::string& key, double& significance, double& cut );
+   bool Store( const std::string& key, const TString& method, double significance, double cut ) const;
+
+   size_t GetNEntries() { Update(); return fEntries.size(); }
+
+ private:
+
+   void Update();
+
+   std::string                                        fPath;
+   std::map<std::string, std::pair<double, double> >  fEntries;   // significance and cut
+   size_t                                             fReadSize;  // up to the last complete line read
+};
+
+//_______________________________________________________________________
+inline SignificanceCache::SignificanceCache( const TString& path )
+   : fPath( path.Data() ), fReadSize( 0 )
+{
+   if (!fPath.empty() && fPath[0] != '/') {
+      char cwd[4096];
+      if (getcwd( cwd, sizeof(cwd) )) fPath = std::string( cwd ) + "/" + fPath;
+   }
+   Update();
+}
+
+//_______________________________________________________________________
+inline std::string SignificanceCache::MakeKey( const std::string& description )
+{
+   // 64 bit FNV-1a
+   unsigned long long hash = 14695981039346656037ULL;
+   for (size_t i = 0; i < description.size(); i++) {
+      hash ^= (unsigned char)description[i];
+      hash *= 1099511628211ULL;
+   }
+   char key[17];
+   snprintf( key, sizeof(key), "%016llx", hash );
+   return key;
+}
+
+//_______________________________________________________________________
+inline void SignificanceCache::Update()
+{
+   std::ifstream in( fPath.c_str(), std::ios::binary );
+   if (!in) return;
+   in.seekg( fReadSize );
+   std::stringstream buffer;
+   buffer << in.rdbuf();
+   std::string text = buffer.str();
+
+   size_t begin = 0, end;
+   while ((end = text.find( '\n', begin )) != std::string::npos) {
+      std::istringstream line( text.substr( begin, end - begin ) );
+      begin = end + 1;
+      std::string key, method;
+      double significance, cut;
+      std::string extra;
+      if ((line >> key >> method >> significance >> cut) && !(line >> extra)) {
+         fEntries[key] = std::make_pair( significance, cut );
+      }
+   }
+   fReadSize += begin;
+}
+
+//_______________________________________________________________________
+inline bool SignificanceCache::Find( const std::string& key, double& significance, double& cut )
+{
+   std::map<std::string, std::pair<double, double> >::const_iterator it = fEntries.find( key );
+   if (it == fEntries.end()) {
+      Update();
+      it = fEntries.find( key );
+      if (it == fEntries.end()) return false;
+   }
+   significance = it->second.first;
+   cut          = it->second.second;
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool SignificanceCache::Store( const std::string& key, const TString& method, double significance, double cut ) const
+{
+   std::ostringstream line;
+   line.precision( 17 );
+   line << key << " " << method << " " << significance << " " << cut << "\n";
+   std::string text = line.str();
+   int fd = open( fPath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644 );
+   bool ok = fd >= 0 && write( fd, text.data(), text.size() ) == (ssize_t)text.size();
+   if (fd >= 0) close( fd );
+   if (!ok) std::cout << "Problem in class \"SignificanceCache\": cannot write " << fPath << std::endl;
+   return ok;
+}
+
+#endif
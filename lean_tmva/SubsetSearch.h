@@ -0,0 +1,226 @@
+// SubsetSearch: runs the trials of a variable subset search in parallel and resumably
+//
+// A trial trains and evaluates the classifiers on one subset of the variables. The
+// trials run in forked copies of the driver, up to nWorkers at a time, each in its
+// own directory <dir>/<trial name>, so that their TMVA.root and weights/ do not
+// collide. A finished trial appends one line to the journal <dir>/journal,
+//
+//    <trial name> <variable choice> <method> <significance> [<method> <significance> ...]
+//
+// in a single write, with the choice as the text of its VariableMask. A search
+// started again on the same directory reads the journal first and skips the
+// trials found there: a killed search resumes with the trials that had not
+// finished, and a trial that failed is run again. A trial that fails does not
+// stop the others.
+//
+//    SubsetSearch search( "subset_search" );
+//    search.AddTrial( "n4_t0", random_ksubset( variables.size(), 4 ) );
+//    search.Run( trial );                     // calls trial.Run( choice, significances )
+//    const std::vector<SubsetSearch::Result>& results = search.GetResults();
+
+#ifndef SubsetSearch__def
+#define SubsetSearch__def
+
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "TString.h"
+
+#include "VariableMask.h"
+
+class SubsetTrial {
+
+ public:
+
+   virtual ~SubsetTrial() {}
+
+   // train and evaluate on the variables in "choice", in the current directory,
+   // adding the significance of each method under its name
+   virtual bool Run( const VariableMask& choice, std::vector<std::pair<std::string, double> >& significances ) = 0;
+};
+
+class SubsetSearch {
+
+ public:
+
+   struct Result {
+      std::string  name;
+      VariableMask choice;
+      std::string  method;
+      double       significance;
+   };
+
+   // nWorkers = 0 runs one trial per core
+   SubsetSearch( const TString& dir, int nWorkers = 0 );
+
+   int GetNWorkers() const { return fNWorkers; }
+
+   // queue a trial, unless the journal already holds it; returns whether it was queued
+   bool AddTrial( const std::string& name, const VariableMask& choice );
+   bool IsFinished( const std::string& name ) const { return fFinished.count( name ) > 0; }
+
+   // run the queued trials; false if a trial failed (it is not journaled and runs
+   // again when the search is resumed)
+   bool Run( SubsetTrial& trial );
+
+   // the results of all journaled trials, including those of earlier runs
+   const std::vector<Result>& GetResults() const { return fResults; }
+
+ private:
+
+   void ReadJournal();
+   bool RunTrial( SubsetTrial& trial, const std::string& name, const VariableMask& choice ) const;
+
+   TString                                            fDir;
+   TString                                            fJournal;
+   int                                                fNWorkers;
+   std::vector<std::pair<std::string, VariableMask> > fTrials;        // queued: name and choice
+   std::set<std::string>                              fFinished;
+   std::vector<Result>                                fResults;
+   size_t                                             fJournalSize;   // up to the last complete line
+   bool                                               fIsTorn;        // the journal ends in an incomplete line
+};
+
+//_______________________________________________________________________
+inline SubsetSearch::SubsetSearch( const TString& dir, int nWorkers )
+   : fDir( dir ), fJournal( dir + "/journal" ),
+     fNWorkers( nWorkers > 0 ? nWorkers : int(sysconf( _SC_NPROCESSORS_ONLN )) ),
+     fJournalSize( 0 ), fIsTorn( false )
+{
+   if (fNWorkers < 1) fNWorkers = 1;
+   ReadJournal();
+   if (!fFinished.empty()) {
+      std::cout << "--- SubsetSearch: resuming after " << fFinished.size() << " trials in " << fJournal << std::endl;
+   }
+}
+
+//_______________________________________________________________________
+inline void SubsetSearch::ReadJournal()
+{
+   fFinished.clear();
+   fResults.clear();
+   std::ifstream in( fJournal.Data() );
+   std::stringstream buffer;
+   buffer << in.rdbuf();
+   std::string text = buffer.str();
+
+   // a line is only complete with its newline: a trial killed while writing is lost
+   size_t begin = 0, end;
+   while ((end = text.find( '\n', begin )) != std::string::npos) {
+      std::istringstream line( text.substr( begin, end - begin ) );
+      begin = end + 1;
+      Result result;
+      std::string choice;
+      if (!(line >> result.name >> choice) || !VariableMask::FromString( choice, result.choice )) continue;
+      std::vector<Result> results;
+      while (line >> result.method >> result.significance) results.push_back( result );
+      if (!line.eof()) continue;
+      fFinished.insert( result.name );
+      fResults.insert( fResults.end(), results.begin(), results.end() );
+   }
+   fJournalSize = begin;
+   fIsTorn      = begin < text.size();
+}
+
+//_______________________________________________________________________
+inline bool SubsetSearch::AddTrial( const std::string& name, const VariableMask& choice )
+{
+   if (IsFinished( name )) return false;
+   fTrials.push_back( std::make_pair( name, choice ) );
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool SubsetSearch::Run( SubsetTrial& trial )
+{
+   mkdir( fDir, 0755 );
+   // drop the incomplete line of a search killed while journaling, so that the
+   // next trial does not append to it
+   if (fIsTorn && truncate( fJournal, fJournalSize ) != 0) {
+      std::cout << "Problem in class \"SubsetSearch\": cannot repair " << fJournal << std::endl;
+      return false;
+   }
+   std::cout.flush();
+   std::cerr.flush();
+
+   bool ok = true, started = true;
+   size_t next = 0;
+   std::map<pid_t, size_t> running;
+   while ((started && next < fTrials.size()) || !running.empty()) {
+      if (started && next < fTrials.size() && (int)running.size() < fNWorkers) {
+         pid_t pid = fork();
+         if (pid == 0) _exit( RunTrial( trial, fTrials[next].first, fTrials[next].second ) ? 0 : 1 );
+         if (pid < 0) {
+            std::cout << "Problem in class \"SubsetSearch\": cannot start trial " << fTrials[next].first << std::endl;
+            ok = started = false;
+            continue;
+         }
+         running[pid] = next++;
+         continue;
+      }
+
+      int status;
+      pid_t pid = waitpid( -1, &status, 0 );
+      if (pid < 0) {
+         if (errno == EINTR) continue;
+         break;
+      }
+      std::map<pid_t, size_t>::iterator it = running.find( pid );
+      if (it == running.end()) continue;
+      if (!WIFEXITED( status ) || WEXITSTATUS( status ) != 0) {
+         std::cout << "Problem in class \"SubsetSearch\": trial " << fTrials[it->second].first << " failed" << std::endl;
+         ok = false;
+      }
+      running.erase( it );
+   }
+   fTrials.clear();
+
+   ReadJournal();
+   return ok;
+}
+
+//_______________________________________________________________________
+inline bool SubsetSearch::RunTrial( SubsetTrial& trial, const std::string& name, const VariableMask& choice ) const
+{
+   // the journal is opened before changing to the directory of the trial
+   TString dir = fDir + "/" + name.c_str();
+   int fd = open( fJournal, O_WRONLY | O_APPEND | O_CREAT, 0644 );
+   if (fd < 0 || (mkdir( dir, 0755 ) != 0 && errno != EEXIST) || chdir( dir ) != 0) {
+      std::cout << "Problem in class \"SubsetSearch\": cannot set up trial " << name << " in " << dir << std::endl;
+      if (fd >= 0) close( fd );
+      return false;
+   }
+
+   std::vector<std::pair<std::string, double> > significances;
+   bool ok = trial.Run( choice, significances );
+   if (ok) {
+      std::ostringstream line;
+      line.precision( 17 );
+      line << name << " " << choice.ToString();
+      for (size_t imethod = 0; imethod < significances.size(); imethod++) {
+         line << " " << significances[imethod].first << " " << significances[imethod].second;
+      }
+      line << "\n";
+      std::string text = line.str();
+      ok = write( fd, text.data(), text.size() ) == (ssize_t)text.size() && fsync( fd ) == 0;
+      if (!ok) std::cout << "Problem in class \"SubsetSearch\": cannot journal trial " << name << std::endl;
+   }
+   close( fd );
+   std::cout.flush();
+   std::cerr.flush();
+   return ok;
+}
+
+#endif
@@ -0,0 +1,195 @@
+// SuccessiveHalving: a scan of method configurations that spends its training on the best ones
+//
+// All candidate configurations are first trained with a small budget, minBudget
+// trees or cycles, on the fraction minFraction of the training events. At each
+// step only the better 1/eta of them, by significance, go on, with the budget and
+// the fraction grown geometrically, until the last one is trained with maxBudget
+// on all events. The budget is given to a configuration as the option
+// "budgetOption" (NTrees, NCycles) appended to its options. The configurations of
+// a step are booked together in one factory of the ClassificationTrial.
+//
+//    SuccessiveHalving halving( "NTrees", 200, 2000, 0.1 );
+//    halving.AddCandidate( Types::kBDT, "BDTG_nCuts10", "!H:!V:BoostType=Grad:...:nCuts=10", 0.9, 1.0, 1000, 0.5, 0.5 );
+//    ...
+//    halving.Run( trial, choice );
+//    const std::vector<SuccessiveHalving::Result>& results = halving.GetResults();
+
+#ifndef SuccessiveHalving__def
+#define SuccessiveHalving__def
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "TString.h"
+#include "TMVA/Types.h"
+
+#include "ClassificationTrial.h"
+#include "VariableMask.h"
+
+class SuccessiveHalving {
+
+ public:
+
+   // the result of a configuration at the last step it was trained in
+   struct Result {
+      TString name;
+      int     step;
+      int     budget;
+      double  fraction;
+      double  significance;
+   };
+
+   SuccessiveHalving( const TString& budgetOption, int minBudget, int maxBudget, double minFraction, int eta = 2 );
+
+   // a configuration, as ClassificationTrial::AddMethod, without the budget option
+   void AddCandidate( TMVA::Types::EMVA type, const TString& name, const TString& options,
+                      double low, double high, int nCuts, double scale = 1, double offset = 0 );
+
+   // number of steps after the first one, for the candidates added so far
+   int GetNSteps() const;
+   int GetBudget( int step ) const;
+   double GetFraction( int step ) const;
+
+   // run all steps on the variables "choice"; false if a training failed
+   bool Run( ClassificationTrial& trial, const VariableMask& choice );
+
+   // one result per candidate, in the order they were added
+   const std::vector<Result>& GetResults() const { return fResults; }
+   // the candidate trained with the full budget, -1 before Run
+   int GetBest() const { return fBest; }
+
+ private:
+
+   struct Candidate {
+      TMVA::Types::EMVA type;
+      TString           name;
+      TString           options;
+      double            low, high;
+      int               nCuts;
+      double            scale, offset;
+   };
+
+   TString                fBudgetOption;
+   int                    fMinBudget;
+   int                    fMaxBudget;
+   double                 fMinFraction;
+   int                    fEta;
+   std::vector<Candidate> fCandidates;
+   std::vector<Result>    fResults;
+   int                    fBest;
+};
+
+//_______________________________________________________________________
+inline SuccessiveHalving::SuccessiveHalving( const TString& budgetOption, int minBudget, int maxBudget,
+                                             double minFraction, int eta )
+   : fBudgetOption( budgetOption ), fMinBudget( minBudget ), fMaxBudget( maxBudget ),
+     fMinFraction( minFraction ), fEta( eta ), fBest( -1 )
+{
+   if (fMaxBudget < 1) fMaxBudget = 1;
+   if (fMinBudget < 1 || fMinBudget > fMaxBudget) fMinBudget = fMaxBudget;
+   if (!(fMinFraction > 0) || fMinFraction > 1) fMinFraction = 1;
+   if (fEta < 2) fEta = 2;
+}
+
+//_______________________________________________________________________
+inline void SuccessiveHalving::AddCandidate( TMVA::Types::EMVA type, const TString& name, const TString& options,
+                                             double low, double high, int nCuts, double scale, double offset )
+{
+   Candidate candidate;
+   candidate.type    = type;
+   candidate.name    = name;
+   candidate.options = options;
+   candidate.low     = low;
+   candidate.high    = high;
+   candidate.nCuts   = nCuts;
+   candidate.scale   = scale;
+   candidate.offset  = offset;
+   fCandidates.push_back( candidate );
+}
+
+//_______________________________________________________________________
+inline int SuccessiveHalving::GetNSteps() const
+{
+   int nsteps = 0;
+   for (size_t n = 1; n < fCandidates.size(); n *= fEta) nsteps++;
+   return nsteps;
+}
+
+//_______________________________________________________________________
+inline int SuccessiveHalving::GetBudget( int step ) const
+{
+   int nsteps = GetNSteps();
+   if (nsteps == 0 || step >= nsteps) return fMaxBudget;
+   double budget = fMinBudget*pow( double(fMaxBudget)/fMinBudget, double(step)/nsteps );
+   return int( floor( budget + 0.5 ) );
+}
+
+//_______________________________________________________________________
+inline double SuccessiveHalving::GetFraction( int step ) const
+{
+   int nsteps = GetNSteps();
+   if (nsteps == 0 || step >= nsteps) return 1;
+   return pow( fMinFraction, double(nsteps - step)/nsteps );
+}
+
+//_______________________________________________________________________
+inline bool SuccessiveHalving::Run( ClassificationTrial& trial, const VariableMask& choice )
+{
+   fResults.assign( fCandidates.size(), Result() );
+   fBest = -1;
+   std::vector<size_t> alive;
+   for (size_t icand = 0; icand < fCandidates.size(); icand++) alive.push_back( icand );
+
+   int nsteps = GetNSteps();
+   for (int step = 0; !alive.empty(); step++) {
+      int budget      = GetBudget( step );
+      double fraction = GetFraction( step );
+      std::cout << "--- SuccessiveHalving: step " << step << " of " << nsteps << ", " << alive.size()
+                << " configurations with " << fBudgetOption << "=" << budget
+                << " on a fraction " << fraction << " of the events" << std::endl;
+
+      trial.ClearMethods();
+      trial.SetTrainingFraction( fraction );
+      for (size_t ialive = 0; ialive < alive.size(); ialive++) {
+         const Candidate& candidate = fCandidates[alive[ialive]];
+         std::ostringstream options;
+         options << candidate.options << ":" << fBudgetOption << "=" << budget;
+         trial.AddMethod( candidate.type, candidate.name, options.str().c_str(), candidate.low, candidate.high,
+                          candidate.nCuts, candidate.scale, candidate.offset );
+      }
+      std::vector<std::pair<std::string, double> > significances;
+      bool ok = trial.Run( choice, significances ) && significances.size() == alive.size();
+      trial.ClearMethods();
+      trial.SetTrainingFraction( 1 );
+      if (!ok) {
+         std::cout << "Problem in class \"SuccessiveHalving\": step " << step << " failed" << std::endl;
+         return false;
+      }
+
+      // the methods are reported in the order they were booked
+      std::vector<std::pair<double, size_t> > ranking;
+      for (size_t ialive = 0; ialive < alive.size(); ialive++) {
+         Result& result      = fResults[alive[ialive]];
+         result.name         = fCandidates[alive[ialive]].name;
+         result.step         = step;
+         result.budget       = budget;
+         result.fraction     = fraction;
+         result.significance = significances[ialive].second;
+         ranking.push_back( std::make_pair( -result.significance, alive[ialive] ) );
+      }
+      if (step >= nsteps) {
+         fBest = int(alive[0]);
+         break;
+      }
+      std::sort( ranking.begin(), ranking.end() );
+      alive.clear();
+      for (size_t irank = 0; irank < (ranking.size() + fEta - 1)/fEta; irank++) alive.push_back( ranking[irank].second );
+   }
+   return true;
+}
+
+#endif
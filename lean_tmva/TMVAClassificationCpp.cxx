@@ -38,6 +38,7 @@
 #include <algorithm>
 #include <ctime>
 #include <cmath>
+#include <sstream>
 
 #include "TChain.h"
 #include "TFile.h"
@@ -56,24 +57,33 @@
 #include "TMVA/Tools.h"
 #include "TMVA/MethodCuts.h"
 
+#include "SignificanceScan.h"
+#include "ParallelEvaluation.h"
+#include "EventCache.h"
+#include "SubsetSearch.h"
+#include "ClassificationTrial.h"
+#include "SignificanceCache.h"
+#include "VariableMask.h"
+#include "MLPConvergence.h"
+
 using namespace TMVA;
 
-long long random_ksubset(int n, int k) {
+VariableMask random_ksubset(int n, int k) {
 	std::vector<int> pool;
 	for (int i = 0; i < n; i++) pool.push_back(i);
-	long long res = 0;
+	VariableMask res;
 	while (k--) {
 		int cand = rand() % pool.size();
-		while (res & (1LL << pool[cand])) cand = rand() % pool.size();
-		res |= (1LL << pool[cand]);
+		while (res.Test(pool[cand])) cand = rand() % pool.size();
+		res.Set(pool[cand]);
 		std::swap(pool[cand], pool[pool.size()-1]);
 		pool.pop_back();
 	}
 	return res;
 }
 
-typedef std::pair<double, std::pair<long long, std::string> > method_stats;
-method_stats make_method_stats(long long v, double r, std::string method) {
+typedef std::pair<double, std::pair<VariableMask, std::string> > method_stats;
+method_stats make_method_stats(const VariableMask& v, double r, std::string method) {
 	return std::make_pair(r, make_pair(v, method));
 }
 
@@ -85,6 +95,21 @@ int main(int argc, char* argv[]) {
 	// This loads the library
 	Tools::Instance();
 
+	// --binned-bdt trains the BDTs with BinnedBDT instead of TMVA, --compare-bdt with
+	// both, reporting TMVA's significance and the BinnedBDT's next to it (see BinnedBDT.h)
+	bool binned_bdt = false, compare_bdt = false;
+	for (int i = 1; i < argc; ) {
+		TString arg = argv[i];
+		if (arg != "--binned-bdt" && arg != "--compare-bdt") {
+			i++;
+			continue;
+		}
+		if (arg == "--binned-bdt") binned_bdt = true;
+		else compare_bdt = true;
+		for (int j = i; j + 1 < argc; j++) argv[j] = argv[j + 1];
+		argc--;
+	}
+
 	int MVA_type;
 	if (argc > 1) MVA_type = atoi(argv[1]);
 	else MVA_type = 3;
@@ -149,379 +174,90 @@ int main(int argc, char* argv[]) {
 	while (fin >> inp[0] >> inp[1] >> inp[2] >> inp[3]) {
 		variables.push_back(inp);
 	}
+	if ((int) variables.size() > VariableMask::kCapacity) {
+		std::cerr << "At most " << VariableMask::kCapacity << " candidate variables are supported" << std::endl;
+		return 1;
+	}
 
-	std::set<method_stats> rankings;
+	// --- Decode every variable of every sample once: all trials train and evaluate from memory
+	std::vector<TString> branches;
+	for (int i = 0; i < (int) variables.size(); i++) {
+		if (variables[i][1] == "analysis_channel") continue;
+		branches.push_back(variables[i][0]);
+	}
+
+	TTree* train_signal[2] = {signal_el, signal_mu};
+	TTree* background[10] = {ttbar_el, ttbar_mu, wjets_el, wjets_mu, zjets_el, zjets_mu, 
+		singletop_el, singletop_mu, diboson_el, diboson_mu};
+	TTree* signal[2] = {signal_test_el, signal_test_mu};
+
+	EventCache* train_signal_cache[2];
+	EventCache* background_cache[10];
+	EventCache* signal_cache[2];
+	for (int s = 0; s < 2; s++) train_signal_cache[s] = EventCache::Load(train_signal[s], branches);
+	for (int bg = 0; bg < 10; bg++) background_cache[bg] = EventCache::Load(background[bg], branches);
+	for (int s = 0; s < 2; s++) signal_cache[s] = EventCache::Load(signal[s], branches);
+	for (int s = 0; s < 2; s++) if (!train_signal_cache[s] || !signal_cache[s]) return 1;
+	for (int bg = 0; bg < 10; bg++) if (!background_cache[bg]) return 1;
+
+	ClassificationTrial trial(variables);
+	for (int s = 0; s < 2; s++) trial.AddTrainingSample(train_signal_cache[s], true);
+	for (int bg = 0; bg < 10; bg++) trial.AddTrainingSample(background_cache[bg], false);
+	for (int bg = 0; bg < 10; bg++) trial.AddTestSample(background_cache[bg], false);
+	for (int s = 0; s < 2; s++) trial.AddTestSample(signal_cache[s], true);
+
+	// TMVA ANN: MLP (recommended ANN) -- all ANNs in TMVA are Multilayer Perceptrons
+	if (Use["MLP"])
+		trial.AddMethod( Types::kMLP, "MLP", "!H:!V:NeuronType=tanh:VarTransform=N:NCycles=700:HiddenLayers=N+5:TestRate=5:!UseRegulator:SamplingTraining=False:EstimatorType=CE" + MLPConvergence::EarlyStopping(),
+				0.7, 1.0, 3000 );
+
+	// Boosted decision trees, scanned on (response+1)/2
+	if (Use["BDT"])
+		trial.AddMethod( Types::kBDT, "BDT",
+				"!H:!V:NTrees=400:nEventsMin=400:MaxDepth=3:BoostType=AdaBoost:SeparationType=GiniIndex:nCuts=20:PruneMethod=NoPruning",
+				0.5, 0.7, 3000, 0.5, 0.5 );
+
+	// results of trainings done before, in this or an earlier search, are not repeated
+	SignificanceCache significance_cache("significances.txt");
+	trial.SetSignificanceCache(&significance_cache);
+
+	trial.SetBinnedBDT(binned_bdt);
+	trial.SetCompareBinnedBDT(compare_bdt);
+
+	// --- Run the trials concurrently, one per core or argv[2] at a time, each in its own
+	// directory under the journal directory. Finished trials are journaled there, so a
+	// search that was stopped resumes with the trials it had not finished. The trials
+	// are resumed by name only, so the journal is kept per configuration.
+	VariableMask all;
+	for (int i = 0; i < (int) variables.size(); i++) all.Set(i);
+	TString journal_dir = "subset_search_";
+	journal_dir += SignificanceCache::MakeKey(trial.Describe(all)).c_str();
+	std::cerr << "Journal of the search: " << journal_dir << std::endl;
+	SubsetSearch search(journal_dir, argc > 2 ? atoi(argv[2]) : 0);
 	const int max_trials = 5;
 	for (int num_used = 4; num_used <= std::min((int) variables.size(),13); num_used++) {
-		for (int trial = 0; trial < max_trials; trial++) {
-
-			// Create a ROOT output file where TMVA will store ntuples, histograms, etc.
-			TString outfileName( "TMVA.root" );
-			TFile* outputFile = TFile::Open( outfileName, "RECREATE" );
-
-			// Create the factory object. Later you can choose the methods
-			// whose performance you'd like to investigate. The factory is 
-			// the only TMVA object you have to interact with
-			//
-			// The first argument is the base of the name of all the
-			// weightfiles in the directory weight/
-			//
-			// The second argument is the output file for the training results
-			// All TMVA output can be suppressed by removing the "!" (not) in
-			// front of the "Silent" argument in the option string
-			Factory *factory = new Factory( "TMVAClassification", outputFile,
-					"!V:Silent:Color:DrawProgressBar:Transformations=I;D;P;G,D:AnalysisType=Classification" );
-
-			std::cerr << std::endl;
-			std::cerr << "================================================" << std::endl;
-			//add a random num_used sized subset of variables to train on.
-			long long variable_choice = random_ksubset(variables.size(), num_used);
-
-			for (int i = 0; i < (int) variables.size(); i++) {
-				if (variables[i][1] == "analysis_channel") continue;
-				long long chosen = variable_choice;
-				chosen &= (1LL << i);
-				if (chosen) {
-					const std::vector<TString>& tup = variables[i];
-					factory->AddVariable(tup[0], tup[1], tup[2], tup[3][0]);
-					std::cerr << "Adding variable: " << tup[1] << std::endl;
-				}
-			}
-			std::cerr << "================================================" << std::endl;
-
-			// global event weights per tree (see below for setting event-wise weights)
-			Double_t signalWeight     = 1.0;
-			Double_t backgroundWeight = 1.0;
-
-			// You can add an arbitrary number of signal or background trees
-			factory->AddSignalTree    ( signal_el,     signalWeight     );
-			factory->AddSignalTree    ( signal_mu,     signalWeight     );
-			factory->AddBackgroundTree( ttbar_el, backgroundWeight );
-			factory->AddBackgroundTree( ttbar_mu, backgroundWeight );
-			factory->AddBackgroundTree( wjets_el, backgroundWeight );
-			factory->AddBackgroundTree( wjets_mu, backgroundWeight );
-			factory->AddBackgroundTree( zjets_el, backgroundWeight );
-			factory->AddBackgroundTree( zjets_mu, backgroundWeight );
-			factory->AddBackgroundTree( singletop_el, backgroundWeight );
-			factory->AddBackgroundTree( singletop_mu, backgroundWeight );
-			factory->AddBackgroundTree( diboson_el, backgroundWeight );
-			factory->AddBackgroundTree( diboson_mu, backgroundWeight );
-
-			// Set individual event weights (the variables must exist in the original TTree)
-			factory->SetSignalWeightExpression    ("weight_1btin_70*weight_70/btweight_70");
-			factory->SetBackgroundWeightExpression("weight_1btin_70*weight_70/btweight_70");
-
-			// Apply additional cuts on the signal and background samples (can be different)
-			TCut mycuts = "weight_70>0 && analysis_channel>0"; // for example: TCut mycuts = "abs(var1)<0.5 && abs(var2-0.5)<1";
-			TCut mycutb = "weight_70>0 && analysis_channel>0"; // for example: TCut mycutb = "abs(var1)<0.5";
-
-			// Tell the factory how to use the training and testing events
-			//
-			// If no numbers of events are given, half of the events in the tree are used 
-			// for training, and the other half for testing:
-			//    factory->PrepareTrainingAndTestTree( mycut, "SplitMode=random:!V" );
-			// To also specify the number of testing events, use:
-			//    factory->PrepareTrainingAndTestTree( mycut,
-			//                                         "NSigTrain=3000:NBkgTrain=3000:NSigTest=3000:NBkgTest=3000:SplitMode=Random:!V" );
-			factory->PrepareTrainingAndTestTree( mycuts, mycutb,
-					"nTrain_Signal=0:nTrain_Background=0:SplitMode=Random:NormMode=NumEvents:!V" );
-
-			// ---- Book MVA methods
-			//
-			// Please lookup the various method configuration options in the corresponding cxx files, eg:
-			// src/MethoCuts.cxx, etc, or here: http://tmva.sourceforge.net/optionRef.html
-
-
-			// TMVA ANN: MLP (recommended ANN) -- all ANNs in TMVA are Multilayer Perceptrons
-			if (Use["MLP"])
-				factory->BookMethod( Types::kMLP, "MLP", "!H:!V:NeuronType=tanh:VarTransform=N:NCycles=700:HiddenLayers=N+5:TestRate=5:!UseRegulator:SamplingTraining=False:EstimatorType=CE" );
-
-			// Boosted decision trees
-			// In later versions of TMVA, use UsedBaggedBoost and BaggedSampleFraction
-			// Instead of UsedBaggedGrad and GradBaggingFraction
-			if (Use["BDT"])
-				factory->BookMethod( Types::kBDT, "BDT",
-						"!H:!V:NTrees=400:nEventsMin=400:MaxDepth=3:BoostType=AdaBoost:SeparationType=GiniIndex:nCuts=20:PruneMethod=NoPruning");
-
-			// ---- Now you can tell the factory to train, test, and evaluate the MVAs
-
-			// Train MVAs using the set of training events
-			factory->TrainAllMethods();
-
-			// ---- Evaluate all MVAs using the set of test events
-			factory->TestAllMethods();
-
-			// ----- Evaluate and compare performance of all configured MVAs
-			factory->EvaluateAllMethods();
-
-			// --------------------------------------------------------------
-
-			// Save the output
-			outputFile->Close();
-
-			std::cerr << "==> Wrote root file: " << outputFile->GetName() << std::endl;
-			std::cerr << "==> TMVAClassification is done!" << std::endl;
-
-			delete factory;
-
-			//std::cerr << "Pausing before application stage..." << std::endl;
-			//sleep(10);
-
-			//=================================== Begin Application =====================================//
-
-			Float_t weight_70, btweight_70, weight_1btin_70;
-			Int_t analysis_channel;
-
-			// Create the Reader Object
-			Reader *reader = new TMVA::Reader( "!Color:!Silent" );	
-
-			std::vector<Float_t> var_val(num_used);
-
-			int cnt = 0;
-			for (int i = 0; i < (int) variables.size(); i++) {
-				if (variables[i][1] == "analysis_channel") continue;
-				long long chosen = variable_choice;
-				chosen &= (1LL << i);
-				if (chosen) {
-					const std::vector<TString>& tup = variables[i];
-					//std::cerr << "Adding variable: " << tup[1] << std::endl;
-					reader->AddVariable( tup[0], &var_val[cnt++] );
-				}
-			}
-
-			// --- Book the MVA methods
-			if (Use["MLP"]) {
-				TString methodName = TString("MLP method");
-				reader->BookMVA( methodName, "weights/TMVAClassification_MLP.weights.xml" );
-			}
-
-			if (Use["BDT"]) {
-				TString methodName = TString("BDT method");
-				reader->BookMVA( methodName, "weights/TMVAClassification_BDT.weights.xml" );
-			}
-
-
-
-			TTree* background[10] = {ttbar_el, ttbar_mu, wjets_el, wjets_mu, zjets_el, zjets_mu, 
-				singletop_el, singletop_mu, diboson_el, diboson_mu};
-
-
-			const int cuts = 20;
-			double l_mlp = 0.7, r_mlp = 1.0;
-			double del_mlp = (r_mlp-l_mlp)/cuts;
-
-			double l_bdt = 0.5, r_bdt = 0.7;
-			double del_bdt = (r_bdt-l_bdt)/cuts;
-
-			double max_mlp_sig = 0, max_bdt_sig = 0;
-			double best_mlp_cut = 0, best_bdt_cut = 0;
-
-			std::vector<double> tot_bg_mlp(cuts, 0), tot_bg_bdt(cuts, 0);
-			for (int bg = 0; bg < 10; bg++) {
-				// Prepare input tree (this must be replaced by your data source)
-				// in this example, there is a toy tree with signal and one with background events
-				// we'll later on use only the "signal" events for the test in this example.
-				//
-
-				//std::cerr << "--- Testing background sample ---" << std::endl;
-
-				TTree* theTree = background[bg];	
-
-				cnt = 0;
-				for (int i = 0; i < (int) variables.size(); i++) {
-					if (variables[i][1] == "analysis_channel") continue;
-					long long chosen = variable_choice;
-					chosen &= (1LL << i);
-					if (chosen) {
-						const std::vector<TString>& tup = variables[i];
-						//std::cerr << "Adding variable: " << tup[1] << std::endl;
-						theTree->SetBranchAddress( tup[0], &var_val[cnt++] );
-					}
-				}
-
-				theTree->SetBranchAddress( "weight_70", &weight_70);
-				theTree->SetBranchAddress( "btweight_70", &btweight_70);
-				theTree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70);
-				theTree->SetBranchAddress( "analysis_channel", &analysis_channel);
-				//std::cerr << "--- Processing: " << theTree->GetEntries() << " events" << std::endl;
-				//TStopwatch sw;
-				//sw.Start();
-
+		for (int t = 0; t < max_trials; t++) {
+			//a random num_used sized subset of variables to train on.
+			std::stringstream name;
+			name << "n" << num_used << "_t" << t;
+			search.AddTrial(name.str(), random_ksubset(variables.size(), num_used));
+		}
+	}
+	// the trials already occupy the cores, so each evaluates its samples in one process
+	trial.SetNEvaluationWorkers(search.GetNWorkers() > 1 ? 1 : 0);
 
+	bool ok = search.Run(trial);
 
-				Int_t nEvent = theTree->GetEntries();
+	std::set<method_stats> rankings;
+	const std::vector<SubsetSearch::Result>& results = search.GetResults();
+	for (size_t i = 0; i < results.size(); i++) {
+		rankings.insert(make_method_stats(results[i].choice, results[i].significance, results[i].method));
+	}
 
-				for (Long64_t ievt=0; ievt<nEvent; ievt++) {
-					//if (ievt%10000 == 0) {
-					//	std::cerr << "--- ... Processing event: " << ievt << std::endl;
-					//}
-
-					theTree->GetEntry(ievt);
-					if (analysis_channel == 0) continue;
-
-					//theTree->Show(ievt);
-
-					Double_t mc_weight = weight_1btin_70*weight_70/btweight_70;
-					// --- Return the MVA outputs and fill into histograms
-					if (Use["MLP"]) {
-						Double_t MVA_MLP = reader->EvaluateMVA( "MLP method" );
-
-						for (int c = 0; c < cuts; c++) {
-							double mva_cut = l_mlp + c*del_mlp;
-							if (MVA_MLP >= mva_cut) {
-								//std::cerr << "got one! " << mc_weight << std::endl; 
-								tot_bg_mlp[c] += mc_weight;
-							}
-						}
-					}
-
-					if (Use["BDT"]) {
-						Double_t MVA_BDT = reader->EvaluateMVA("BDT method");	
-						//std::cerr << MVA_BDT << std::endl;
-						for (int c = 0; c < cuts; c++) {
-							double mva_cut = l_bdt + c*del_bdt;
-
-							if ((MVA_BDT+1)/2.0 >= mva_cut) {
-								//std::cerr << "got one!" << mc_weight << std::endl;
-								tot_bg_bdt[c] += mc_weight;
-							}
-						}
-					}
-				}
-
-				theTree->ResetBranchAddresses();
-				// Get elapsed time
-				//sw.Stop();
-				//std::cerr << "--- End of event loop: "; //sw.Print();
-				//std::cerr << "==> TMVAClassificationApplication is done!" << std::endl << std::endl;
-
-			}
-
-			TTree* signal[2] = {signal_test_el, signal_test_mu};
-
-			std::vector<double> signal_mlp(cuts, 0), signal_bdt(cuts, 0);
-			for (int s = 0; s < 2; s++) {
-				// Prepare input tree (this must be replaced by your data source)
-				// in this example, there is a toy tree with signal and one with background events
-				// we'll later on use only the "signal" events for the test in this example.
-				//
-
-				//std::cerr << "--- Testing signal sample ---" << std::endl;
-
-				TTree* theTree = signal[s];	
-
-				cnt = 0;
-				for (int i = 0; i < (int) variables.size(); i++) {
-					if (variables[i][1] == "analysis_channel") continue;
-					long long chosen = variable_choice;
-					chosen &= (1LL << i);
-					if (chosen) {
-						const std::vector<TString>& tup = variables[i];
-						//std::cerr << "Adding variable: " << tup[1] << std::endl;
-						theTree->SetBranchAddress( tup[1], &var_val[cnt++] );
-					}
-				}
-
-				theTree->SetBranchAddress( "weight_70", &weight_70);
-				theTree->SetBranchAddress( "btweight_70", &btweight_70);
-				theTree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70);
-				theTree->SetBranchAddress( "analysis_channel", &analysis_channel);
-				//std::cerr << "--- Processing: " << theTree->GetEntries() << " events" << std::endl;
-				//TStopwatch sw;
-				//sw.Start();
-
-
-
-				Int_t nEvent = theTree->GetEntries();
-
-				for (Long64_t ievt=0; ievt<nEvent; ievt++) {
-					//if (ievt%10000 == 0) {
-					//	std::cerr << "--- ... Processing event: " << ievt << std::endl;
-					//}
-
-					theTree->GetEntry(ievt);
-					if (analysis_channel == 0) continue;
-
-					//theTree->Show(ievt);
-
-					Double_t mc_weight = weight_1btin_70*weight_70/btweight_70;
-					// --- Return the MVA outputs and fill into histograms
-					if (Use["MLP"]) {
-						Double_t MVA_MLP = reader->EvaluateMVA( "MLP method" );
-						for (int c = 0; c < cuts; c++) {
-							double mva_cut = l_mlp + c*del_mlp;
-
-							if (MVA_MLP >= mva_cut) {
-								//std::cerr << "got one! " << mc_weight << std::endl; 
-								signal_mlp[c] += mc_weight;
-							}
-						}
-					}
-
-					if (Use["BDT"]) {
-						Double_t MVA_BDT = reader->EvaluateMVA("BDT method");	
-						for (int c = 0; c < cuts; c++) {
-							double mva_cut = l_bdt + c*del_bdt;
-
-							//std::cerr << MVA_BDT << std::endl;
-
-							if ((MVA_BDT+1)/2.0 >= mva_cut) {
-								//std::cerr << "got one!" << mc_weight << std::endl;
-								signal_bdt[c] += mc_weight;
-							}
-						}
-					}
-				}
-
-				theTree->ResetBranchAddresses();
-				// Get elapsed time
-				//sw.Stop();
-				//std::cerr << "--- End of event loop: "; //sw.Print();
-
-
-
-				//sleep(1);
-				//std::cerr << "==> TMVAClassificationApplication is done!" << std::endl << std::endl;
-
-
-				//if (ievt % 10000 == 0)
-				//	std::cerr << signal_mlp << " " << std::signal_bdt < endl;
-				if (Use["MLP"]) {
-					for (int c = 0; c < cuts; c++) {
-						double sig = signal_mlp[c]/sqrt(signal_mlp[c]+tot_bg_mlp[c]);
-						if (max_mlp_sig < sig) {
-							best_mlp_cut = l_mlp + c*del_mlp;
-							max_mlp_sig = sig;
-						}
-					}
-				}
-
-				if (Use["BDT"]) {
-					for (int c = 0; c < cuts; c++) {
-						double sig = signal_bdt[c]/sqrt(signal_bdt[c]+tot_bg_bdt[c]);
-						if (max_bdt_sig < sig) {
-							best_bdt_cut = l_bdt + c*del_bdt;
-							max_bdt_sig = sig;
-						}
-					}
-				}
-			}
-
-
-			delete reader;
-			//get efficiency of methods, compare with current bests
-			if (Use["MLP"]) {
-				std::cerr << "MLP Significance: " << max_mlp_sig << " at cut " << best_mlp_cut << std::endl;
-				rankings.insert(make_method_stats(variable_choice, max_mlp_sig, "MLP"));
-			}
-
-			if (Use["BDT"]) {
-				std::cerr << "BDT Significance: " << max_bdt_sig << " at cut " << best_bdt_cut << std::endl;
-				rankings.insert(make_method_stats(variable_choice, max_bdt_sig, "BDT"));
-			}
-		}
+	for (int s = 0; s < 2; s++) delete train_signal_cache[s];
+	for (int bg = 0; bg < 10; bg++) delete background_cache[bg];
+	for (int s = 0; s < 2; s++) delete signal_cache[s];
 
-	}
 	std::set<method_stats>::iterator it;
 	std::cout << "Best variables:" << std::endl;
 	for (it = rankings.begin(); it != rankings.end(); it++) {
@@ -530,7 +266,7 @@ int main(int argc, char* argv[]) {
 		std::cout << "Method Name: " << (it->second).second << std::endl;
 		std::cout << "variables used: ";
 		for (int i = 0; i < (int) variables.size(); i++) {
-			if ((it->second).first & (1LL << i)) std::cout << "[ " << variables[i][1] << " ] ";
+			if ((it->second).first.Test(i)) std::cout << "[ " << variables[i][1] << " ] ";
 		}
 		cout << endl;
 		std::cout << "================================================" << std::endl;
@@ -540,4 +276,5 @@ int main(int argc, char* argv[]) {
 	//if (!gROOT->IsBatch()) TMVAGui( outfileName );
 	//gApplication->Terminate(0);
 
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,308 @@
+/**********************************************************************************
+ * Greedy variable selection: forward selection or backward elimination of the    *
+ * variables of a variable list file, with the training and evaluation of         *
+ * TMVAClassificationCpp:                                                         *
+ *                                                                                *
+ *    ./TMVAClassificationGreedyCpp variables.txt [MVA type] [forward|backward]   *
+ *                                  [proxy candidates] [concurrent trials]        *
+ *                                                                                *
+ * Forward selection starts from no variable and adds at each step the one whose  *
+ * trial has the best significance, up to 13 variables; backward elimination      *
+ * starts from all of them and removes one per step, down to 4. The trials of a   *
+ * step run concurrently (see SubsetSearch.h) and are journaled in                *
+ * greedy_forward_<key>/ or greedy_backward_<key>/, so a stopped selection        *
+ * resumes there; the key is a hash of the variables, methods, samples and        *
+ * options, so a selection with another configuration starts afresh.              *
+ * With proxy candidates = k > 0, every candidate of a step is first trained      *
+ * with a small BDT and only the k best of them with the methods of the MVA type  *
+ * (1: MLP, 2: BDT, 3: both, the MLP then choosing the variables).                *
+ **********************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include <sstream>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TString.h"
+
+#include "TMVA/Tools.h"
+#include "TMVA/Types.h"
+
+#include "EventCache.h"
+#include "SubsetSearch.h"
+#include "ClassificationTrial.h"
+#include "SignificanceCache.h"
+#include "VariableMask.h"
+#include "MLPConvergence.h"
+
+using namespace TMVA;
+
+typedef std::pair<double, std::pair<VariableMask, std::string> > method_stats;
+method_stats make_method_stats(const VariableMask& v, double r, std::string method) {
+	return std::make_pair(r, make_pair(v, method));
+}
+
+// significance of "method" in each journaled trial, by trial name
+std::map<std::string, double> significances_of(const std::vector<SubsetSearch::Result>& results, const std::string& method) {
+	std::map<std::string, double> significances;
+	for (size_t i = 0; i < results.size(); i++) {
+		if (results[i].method == method) significances[results[i].name] = results[i].significance;
+	}
+	return significances;
+}
+
+int main(int argc, char* argv[]) {
+	// This loads the library
+	Tools::Instance();
+
+	// --binned-bdt trains the BDTs with BinnedBDT instead of TMVA, --compare-bdt with
+	// both, reporting TMVA's significance and the BinnedBDT's next to it (see BinnedBDT.h)
+	bool binned_bdt = false, compare_bdt = false;
+	for (int i = 1; i < argc; ) {
+		TString arg = argv[i];
+		if (arg != "--binned-bdt" && arg != "--compare-bdt") {
+			i++;
+			continue;
+		}
+		if (arg == "--binned-bdt") binned_bdt = true;
+		else compare_bdt = true;
+		for (int j = i; j + 1 < argc; j++) argv[j] = argv[j + 1];
+		argc--;
+	}
+
+	if (argc == 1) {
+		std::cerr << "Filename of input variables needed!" << std::endl;
+		return 0;
+	}
+	std::fstream fin(argv[1], std::fstream::in);
+
+	int MVA_type = argc > 2 ? atoi(argv[2]) : 3;
+	std::map<std::string,int> Use;
+	Use["MLP"] = bool(1&MVA_type);
+	Use["BDT"] = bool(2&MVA_type);
+	std::string select_method = Use["MLP"] ? "MLP" : "BDT";
+
+	bool forward = argc <= 3 || TString(argv[3]) != "backward";
+	int proxy_keep = argc > 4 ? atoi(argv[4]) : 0;
+	const int min_used = 4, max_used = 13;
+
+	std::cerr << std::endl;
+	std::cerr << "==> Start TMVAClassificationGreedy" << std::endl;
+
+	// Read training and test data  
+	TString data_path = "/mnt/xrootdb/alister/MVA_studies/samples/"; 
+	TFile *input_sig_el = TFile::Open(data_path + "nominal_el/tprime_650_1M.root");
+	TFile *input_sig_mu = TFile::Open(data_path + "nominal_mu/tprime_650_1M.root");
+
+
+	TFile *input_sig_test_el = TFile::Open(data_path + "nominal_el/tprime_650.root", "READ");
+	TFile *input_sig_test_mu = TFile::Open(data_path + "nominal_mu/tprime_650.root", "READ");
+
+	TFile *input_ttbar_el = TFile::Open(data_path + "nominal_el/ttbar.root");
+	TFile *input_ttbar_mu = TFile::Open(data_path + "nominal_mu/ttbar.root");
+	TFile *input_wjets_el = TFile::Open(data_path + "nominal_el/wjets.root");
+	TFile *input_wjets_mu = TFile::Open(data_path + "nominal_mu/wjets.root");
+	TFile *input_zjets_el = TFile::Open(data_path + "nominal_el/zjets.root");
+	TFile *input_zjets_mu = TFile::Open(data_path + "nominal_mu/zjets.root");
+	TFile *input_singletop_el = TFile::Open(data_path + "nominal_el/singletop.root");
+	TFile *input_singletop_mu = TFile::Open(data_path + "nominal_mu/singletop.root");
+	TFile *input_diboson_el = TFile::Open(data_path + "nominal_el/diboson.root");
+	TFile *input_diboson_mu = TFile::Open(data_path + "nominal_mu/diboson.root");
+
+	// --- Register the training and test trees
+	TTree *signal_el  = (TTree*)input_sig_el->Get("mini");
+	TTree *signal_mu  = (TTree*)input_sig_mu->Get("mini");
+
+	TTree *signal_test_el  = (TTree*)input_sig_test_el->Get("mini");
+	TTree *signal_test_mu  = (TTree*)input_sig_test_mu->Get("mini");
+
+	TTree *ttbar_el = (TTree*)input_ttbar_el->Get("mini");
+	TTree *ttbar_mu = (TTree*)input_ttbar_mu->Get("mini");
+	TTree *wjets_el = (TTree*)input_wjets_el->Get("mini");
+	TTree *wjets_mu = (TTree*)input_wjets_mu->Get("mini");
+	TTree *zjets_el = (TTree*)input_zjets_el->Get("mini");
+	TTree *zjets_mu = (TTree*)input_zjets_mu->Get("mini");
+	TTree *singletop_el = (TTree*)input_singletop_el->Get("mini");
+	TTree *singletop_mu = (TTree*)input_singletop_mu->Get("mini");
+	TTree *diboson_el = (TTree*)input_diboson_el->Get("mini");
+	TTree *diboson_mu = (TTree*)input_diboson_mu->Get("mini");
+
+	std::vector<std::vector<TString> > variables; //each variable set specified in a 4-tuple.
+	std::vector<TString> inp(4); //var, title, unit, type.
+	while (fin >> inp[0] >> inp[1] >> inp[2] >> inp[3]) {
+		variables.push_back(inp);
+	}
+	if ((int) variables.size() > VariableMask::kCapacity) {
+		std::cerr << "At most " << VariableMask::kCapacity << " candidate variables are supported" << std::endl;
+		return 1;
+	}
+
+	// --- Decode every variable of every sample once: all trials train and evaluate from memory
+	std::vector<TString> branches;
+	VariableMask all;
+	for (int i = 0; i < (int) variables.size(); i++) {
+		if (variables[i][1] == "analysis_channel") continue;
+		branches.push_back(variables[i][0]);
+		all.Set(i);
+	}
+
+	TTree* train_signal[2] = {signal_el, signal_mu};
+	TTree* background[10] = {ttbar_el, ttbar_mu, wjets_el, wjets_mu, zjets_el, zjets_mu, 
+		singletop_el, singletop_mu, diboson_el, diboson_mu};
+	TTree* signal[2] = {signal_test_el, signal_test_mu};
+
+	EventCache* train_signal_cache[2];
+	EventCache* background_cache[10];
+	EventCache* signal_cache[2];
+	for (int s = 0; s < 2; s++) train_signal_cache[s] = EventCache::Load(train_signal[s], branches);
+	for (int bg = 0; bg < 10; bg++) background_cache[bg] = EventCache::Load(background[bg], branches);
+	for (int s = 0; s < 2; s++) signal_cache[s] = EventCache::Load(signal[s], branches);
+	for (int s = 0; s < 2; s++) if (!train_signal_cache[s] || !signal_cache[s]) return 1;
+	for (int bg = 0; bg < 10; bg++) if (!background_cache[bg]) return 1;
+
+	// --- The trials: the methods of TMVAClassificationCpp, and the small BDT that ranks the candidates
+	ClassificationTrial trial(variables), proxy(variables);
+	ClassificationTrial* trials[2] = {&trial, &proxy};
+	for (int t = 0; t < 2; t++) {
+		for (int s = 0; s < 2; s++) trials[t]->AddTrainingSample(train_signal_cache[s], true);
+		for (int bg = 0; bg < 10; bg++) trials[t]->AddTrainingSample(background_cache[bg], false);
+		for (int bg = 0; bg < 10; bg++) trials[t]->AddTestSample(background_cache[bg], false);
+		for (int s = 0; s < 2; s++) trials[t]->AddTestSample(signal_cache[s], true);
+	}
+	if (Use["MLP"])
+		trial.AddMethod( Types::kMLP, "MLP", "!H:!V:NeuronType=tanh:VarTransform=N:NCycles=700:HiddenLayers=N+5:TestRate=5:!UseRegulator:SamplingTraining=False:EstimatorType=CE" + MLPConvergence::EarlyStopping(),
+				0.7, 1.0, 3000 );
+	if (Use["BDT"])
+		trial.AddMethod( Types::kBDT, "BDT",
+				"!H:!V:NTrees=400:nEventsMin=400:MaxDepth=3:BoostType=AdaBoost:SeparationType=GiniIndex:nCuts=20:PruneMethod=NoPruning",
+				0.5, 0.7, 3000, 0.5, 0.5 );
+	proxy.AddMethod( Types::kBDT, "Proxy",
+			"!H:!V:NTrees=50:nEventsMin=400:MaxDepth=2:BoostType=AdaBoost:SeparationType=GiniIndex:nCuts=10:PruneMethod=NoPruning",
+			0.0, 1.0, 1000, 0.5, 0.5 );
+
+	// results of trainings done before, in this or an earlier selection or search
+	SignificanceCache significance_cache("significances.txt");
+	trial.SetSignificanceCache(&significance_cache);
+	proxy.SetSignificanceCache(&significance_cache);
+
+	trial.SetBinnedBDT(binned_bdt);
+	trial.SetCompareBinnedBDT(compare_bdt);
+	proxy.SetBinnedBDT(binned_bdt);
+
+	// the trials are resumed by name only, so the journal is kept per configuration
+	std::stringstream configuration;
+	configuration << trial.Describe(all) << select_method << "\n";
+	if (proxy_keep > 0) configuration << proxy.Describe(all) << "proxy " << proxy_keep << "\n";
+	TString journal_dir = forward ? "greedy_forward_" : "greedy_backward_";
+	journal_dir += SignificanceCache::MakeKey(configuration.str()).c_str();
+	std::cerr << "Journal of the selection: " << journal_dir << std::endl;
+	SubsetSearch search(journal_dir, argc > 5 ? atoi(argv[5]) : 0);
+	trial.SetNEvaluationWorkers(search.GetNWorkers() > 1 ? 1 : 0);
+	proxy.SetNEvaluationWorkers(search.GetNWorkers() > 1 ? 1 : 0);
+
+	// --- Add (or remove) one variable per step
+	VariableMask current = forward ? VariableMask() : all;
+	std::vector<std::pair<VariableMask, double> > path;
+	std::set<method_stats> rankings;
+	bool ok = true;
+	while (forward ? current.Count() < std::min(max_used, all.Count())
+			: current.Count() > min_used) {
+		int num_used = current.Count() + (forward ? 1 : -1);
+
+		// the candidates: current with one variable added or removed, named after the step and variable
+		std::vector<std::pair<std::string, VariableMask> > candidates;
+		VariableMask steps = forward ? all ^ current : current;
+		for (int i = steps.First(); i >= 0; i = steps.Next(i)) {
+			std::stringstream name;
+			name << (forward ? "f" : "b") << num_used << "_v" << i;
+			VariableMask candidate = current;
+			candidate.Flip(i);
+			candidates.push_back(std::make_pair(name.str(), candidate));
+		}
+
+		if (proxy_keep > 0 && (int) candidates.size() > proxy_keep) {
+			for (size_t c = 0; c < candidates.size(); c++) search.AddTrial("p_" + candidates[c].first, candidates[c].second);
+			search.Run(proxy);
+			std::map<std::string, double> proxy_sig = significances_of(search.GetResults(), "Proxy");
+			std::vector<std::pair<double, size_t> > ranked;
+			for (size_t c = 0; c < candidates.size(); c++) {
+				std::map<std::string, double>::const_iterator it = proxy_sig.find("p_" + candidates[c].first);
+				if (it != proxy_sig.end()) ranked.push_back(std::make_pair(it->second, c));
+			}
+			std::sort(ranked.rbegin(), ranked.rend());
+			std::vector<std::pair<std::string, VariableMask> > kept;
+			for (int k = 0; k < proxy_keep && k < (int) ranked.size(); k++) kept.push_back(candidates[ranked[k].second]);
+			candidates = kept;
+		}
+
+		for (size_t c = 0; c < candidates.size(); c++) search.AddTrial(candidates[c].first, candidates[c].second);
+		search.Run(trial);
+
+		// rank the finished candidates, and continue from the best one
+		const std::vector<SubsetSearch::Result>& results = search.GetResults();
+		std::map<std::string, double> step_sig = significances_of(results, select_method);
+		VariableMask best_choice;
+		double best_sig = -1;
+		for (size_t c = 0; c < candidates.size(); c++) {
+			for (size_t r = 0; r < results.size(); r++) {
+				if (results[r].name == candidates[c].first)
+					rankings.insert(make_method_stats(results[r].choice, results[r].significance, results[r].method));
+			}
+			std::map<std::string, double>::const_iterator it = step_sig.find(candidates[c].first);
+			if (it != step_sig.end() && it->second > best_sig) {
+				best_sig = it->second;
+				best_choice = candidates[c].second;
+			}
+		}
+		if (best_sig < 0) {
+			std::cerr << "No trial with " << num_used << " variables finished" << std::endl;
+			ok = false;
+			break;
+		}
+
+		VariableMask changed = current ^ best_choice;
+		for (int i = changed.First(); i >= 0; i = changed.Next(i))
+			std::cerr << (forward ? "Adding " : "Removing ") << variables[i][1] << ": ";
+		std::cerr << num_used << " variables, " << select_method << " Significance: " << best_sig << std::endl;
+		current = best_choice;
+		path.push_back(std::make_pair(current, best_sig));
+	}
+
+	for (int s = 0; s < 2; s++) delete train_signal_cache[s];
+	for (int bg = 0; bg < 10; bg++) delete background_cache[bg];
+	for (int s = 0; s < 2; s++) delete signal_cache[s];
+
+	std::cout << "Selection path:" << std::endl;
+	size_t best = 0;
+	for (size_t p = 0; p < path.size(); p++) {
+		std::cout << path[p].first.Count() << " variables: " << path[p].second << std::endl;
+		if (path[p].second > path[best].second) best = p;
+	}
+	if (!path.empty()) {
+		std::cout << "================================================" << std::endl;
+		std::cout << "Best " << select_method << " Significance: " << path[best].second << std::endl;
+		std::cout << "variables used: ";
+		for (int i = 0; i < (int) variables.size(); i++) {
+			if (path[best].first.Test(i)) std::cout << "[ " << variables[i][1] << " ] ";
+		}
+		std::cout << std::endl;
+		std::cout << "================================================" << std::endl;
+	}
+
+	std::set<method_stats>::iterator it;
+	std::cout << "All trials:" << std::endl;
+	for (it = rankings.begin(); it != rankings.end(); it++) {
+		std::cout << "Significance: " << it->first << ", Method Name: " << (it->second).second << ", variables used: ";
+		for (int i = 0; i < (int) variables.size(); i++) {
+			if ((it->second).first.Test(i)) std::cout << "[ " << variables[i][1] << " ] ";
+		}
+		std::cout << std::endl;
+	}
+	return ok ? 0 : 1;
+}
@@ -56,6 +56,11 @@
 #include "TMVA/Tools.h"
 #include "TMVA/MethodCuts.h"
 
+#include "SignificanceScan.h"
+#include "ParallelEvaluation.h"
+#include "EventCache.h"
+#include "MLPConvergence.h"
+
 using namespace TMVA;
 
 typedef std::pair<double, std::pair<long long, std::string> > method_stats;
@@ -143,6 +148,27 @@ int main(int argc, char* argv[]) {
 		variables.push_back(inp);
 	}
 
+	// --- Decode the variables of every sample once, with the event weights and preselection
+	std::vector<TString> branches;
+	for (int i = 0; i < (int) variables.size(); i++) {
+		if (variables[i][1] == "analysis_channel") continue;
+		branches.push_back(variables[i][0]);
+	}
+
+	TTree* train_signal[2] = {signal_el, signal_mu};
+	TTree* background[10] = {ttbar_el, ttbar_mu, wjets_el, wjets_mu, zjets_el, zjets_mu, 
+		singletop_el, singletop_mu, diboson_el, diboson_mu};
+	TTree* signal[2] = {signal_test_el, signal_test_mu};
+
+	EventCache* train_signal_cache[2];
+	EventCache* background_cache[10];
+	EventCache* signal_cache[2];
+	for (int s = 0; s < 2; s++) train_signal_cache[s] = EventCache::Load(train_signal[s], branches);
+	for (int bg = 0; bg < 10; bg++) background_cache[bg] = EventCache::Load(background[bg], branches);
+	for (int s = 0; s < 2; s++) signal_cache[s] = EventCache::Load(signal[s], branches);
+	for (int s = 0; s < 2; s++) if (!train_signal_cache[s] || !signal_cache[s]) return 1;
+	for (int bg = 0; bg < 10; bg++) if (!background_cache[bg]) return 1;
+
 	std::set<method_stats> rankings;
 	int num_used = variables.size();
 	// Create a ROOT output file where TMVA will store ntuples, histograms, etc.
@@ -166,39 +192,25 @@ int main(int argc, char* argv[]) {
 	std::cerr << "================================================" << std::endl;
 	//add a random num_used sized subset of variables to train on.
 
+	std::vector<TString> train_branches;
 	for (int i = 0; i < num_used; i++) {
 		if (variables[i][1] == "analysis_channel") continue;
 		const std::vector<TString>& tup = variables[i];
 		factory->AddVariable(tup[0], tup[1], tup[2], tup[3][0]);
+		train_branches.push_back(tup[0]);
 		std::cerr << "Adding variable: " << tup[1] << std::endl;
 	}
 	std::cerr << "================================================" << std::endl;
 
-	// global event weights per tree (see below for setting event-wise weights)
-	Double_t signalWeight     = 1.0;
-	Double_t backgroundWeight = 1.0;
-
-	// You can add an arbitrary number of signal or background trees
-	factory->AddSignalTree    ( signal_el,     signalWeight     );
-	factory->AddSignalTree    ( signal_mu,     signalWeight     );
-	factory->AddBackgroundTree( ttbar_el, backgroundWeight );
-	factory->AddBackgroundTree( ttbar_mu, backgroundWeight );
-	factory->AddBackgroundTree( wjets_el, backgroundWeight );
-	factory->AddBackgroundTree( wjets_mu, backgroundWeight );
-	factory->AddBackgroundTree( zjets_el, backgroundWeight );
-	factory->AddBackgroundTree( zjets_mu, backgroundWeight );
-	factory->AddBackgroundTree( singletop_el, backgroundWeight );
-	factory->AddBackgroundTree( singletop_mu, backgroundWeight );
-	factory->AddBackgroundTree( diboson_el, backgroundWeight );
-	factory->AddBackgroundTree( diboson_mu, backgroundWeight );
-
-	// Set individual event weights (the variables must exist in the original TTree)
-	factory->SetSignalWeightExpression    ("weight_1btin_70*weight_70/btweight_70");
-	factory->SetBackgroundWeightExpression("weight_1btin_70*weight_70/btweight_70");
+	// Add the cached events: they pass "weight_70>0 && analysis_channel==1", carry the
+	// event weight weight_1btin_70*weight_70/btweight_70 and are already split into
+	// training and test events
+	for (int s = 0; s < 2; s++) train_signal_cache[s]->AddToFactory(factory, true, train_branches, EventCache::kTrainableChannelOne);
+	for (int bg = 0; bg < 10; bg++) background_cache[bg]->AddToFactory(factory, false, train_branches, EventCache::kTrainableChannelOne);
 
 	// Apply additional cuts on the signal and background samples (can be different)
-	TCut mycuts = "weight_70>0 && analysis_channel==1"; // for example: TCut mycuts = "abs(var1)<0.5 && abs(var2-0.5)<1";
-	TCut mycutb = "weight_70>0 && analysis_channel==1"; // for example: TCut mycutb = "abs(var1)<0.5";
+	TCut mycuts = ""; // for example: TCut mycuts = "abs(var1)<0.5 && abs(var2-0.5)<1";
+	TCut mycutb = ""; // for example: TCut mycutb = "abs(var1)<0.5";
 
 	// Tell the factory how to use the training and testing events
 	//
@@ -219,7 +231,7 @@ int main(int argc, char* argv[]) {
 
 	// TMVA ANN: MLP (recommended ANN) -- all ANNs in TMVA are Multilayer Perceptrons
 	if (Use["MLP"])
-		factory->BookMethod( Types::kMLP, "MLP", "!H:!V:NeuronType=tanh:VarTransform=N:NCycles=600:HiddenLayers=N-1,N,3:TestRate=5:!UseRegulator" );
+		factory->BookMethod( Types::kMLP, "MLP", "!H:!V:NeuronType=tanh:VarTransform=N:NCycles=600:HiddenLayers=N-1,N,3:TestRate=5:!UseRegulator" + MLPConvergence::EarlyStopping() );
 
 	// Boosted decision trees
 	// In later versions of TMVA, use UsedBaggedBoost and BaggedSampleFraction
@@ -244,6 +256,11 @@ int main(int argc, char* argv[]) {
 	// Save the output
 	outputFile->Close();
 
+	MLPConvergence convergence;
+	if (Use["MLP"] && convergence.Read("TMVA.root", "MLP"))
+		std::cerr << "MLP stopped at cycle " << convergence.GetStopCycle() << ", best test estimator "
+			<< convergence.GetBestEstimator() << " at cycle " << convergence.GetBestCycle() << std::endl;
+
 	std::cerr << "==> Wrote root file: " << outputFile->GetName() << std::endl;
 	std::cerr << "==> TMVAClassification is done!" << std::endl;
 
@@ -256,18 +273,18 @@ int main(int argc, char* argv[]) {
 
 	// Create the Reader Object
 
-	Float_t weight_70, btweight_70, weight_1btin_70;
-	Int_t analysis_channel;
-
 	Reader *reader = new TMVA::Reader( "!Color:!Silent" );	
 	std::vector<Float_t> var_val(num_used);
 
+	std::vector<TString> background_branches, signal_branches;
 	int cnt = 0;
 	for (int i = 0; i < num_used; i++) {
 		if (variables[i][1] == "analysis_channel") continue;
 		const std::vector<TString>& tup = variables[i];
 		//std::cerr << "Adding variable: " << tup[1] << std::endl;
 		reader->AddVariable( tup[0], &var_val[cnt++] );
+		background_branches.push_back( tup[0] );
+		signal_branches.push_back( tup[0] );
 	}
 
 	// --- Book the MVA methods
@@ -281,168 +298,46 @@ int main(int argc, char* argv[]) {
 		reader->BookMVA( methodName, "weights/TMVAClassification_BDTG.weights.xml" );
 	}
 
-	TTree* background[10] = {ttbar_el, ttbar_mu, wjets_el, wjets_mu, zjets_el, zjets_mu, 
-		singletop_el, singletop_mu, diboson_el, diboson_mu};
-
-	double tot_bg_mlp = 0, tot_bg_bdtg = 0;
-	for (int bg = 0; bg < 10; bg++) {
-		// Prepare input tree (this must be replaced by your data source)
-		// in this example, there is a toy tree with signal and one with background events
-		// we'll later on use only the "signal" events for the test in this example.
-		//
-
-		std::cerr << "--- Testing background sample ---" << std::endl;
-
-		TTree* theTree = background[bg];	
-
-		cnt = 0;
-		for (int i = 0; i < num_used; i++) {
-			if (variables[i][1] == "analysis_channel") continue;
-			const std::vector<TString>& tup = variables[i];
-			//std::cerr << "Adding variable: " << tup[1] << std::endl;
-			theTree->SetBranchAddress( tup[1], &var_val[cnt++] );
-		}
-
-		theTree->SetBranchAddress( "weight_70", &weight_70);
-		theTree->SetBranchAddress( "btweight_70", &btweight_70);
-		theTree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70);
-		theTree->SetBranchAddress( "analysis_channel", &analysis_channel);
-		//std::cerr << "--- Processing: " << theTree->GetEntries() << " events" << std::endl;
-		//TStopwatch sw;
-		//sw.Start();
-
-		Int_t nEvent = theTree->GetEntries();
-
-		for (Long64_t ievt=0; ievt<nEvent; ievt++) {
-			//if (ievt%10000 == 0) {
-			//	std::cerr << "--- ... Processing event: " << ievt << std::endl;
-			//}
-
-			theTree->GetEntry(ievt);
-			if (analysis_channel == 0) continue;
-
-			//theTree->Show(ievt);
-
-			Double_t mc_weight = weight_1btin_70*weight_70/btweight_70;
-			// --- Return the MVA outputs and fill into histograms
-			if (Use["MLP"]) {
-				Double_t MVA_MLP = reader->EvaluateMVA( "MLP method" );
-				if (MVA_MLP >= 0.9965) {
-					//std::cerr << "got one! " << mc_weight << std::endl; 
-					tot_bg_mlp += mc_weight;
-				}
-			}
-
-			if (Use["BDTG"]) {
-				Double_t MVA_BDTG = reader->EvaluateMVA("BDTG method");	
-				//std::cerr << MVA_BDTG << std::endl;
-				if ((MVA_BDTG+1)/2.0 >= 0.95) {
-					//std::cerr << "got one!" << mc_weight << std::endl;
-					tot_bg_bdtg += mc_weight;
-				}
-			}
-		}
-
-		theTree->ResetBranchAddresses();
-		// Get elapsed time
-		//sw.Stop();
-		std::cerr << "--- End of event loop: "; //sw.Print();
-		std::cerr << "==> TMVAClassificationApplication is done!" << std::endl << std::endl;
-	}
-
-	TTree* signal[2] = {signal_test_el, signal_test_mu};
-
-	double signal_mlp = 0, signal_bdtg = 0;
-	for (int s = 0; s < 2; s++) {
-		// Prepare input tree (this must be replaced by your data source)
-		// in this example, there is a toy tree with signal and one with background events
-		// we'll later on use only the "signal" events for the test in this example.
-		//
-
-		std::cerr << "--- Testing signal sample ---" << std::endl;
-
-		TTree* theTree = signal[s];	
-
-		cnt = 0;
-		for (int i = 0; i < num_used; i++) {
-			if (variables[i][1] == "analysis_channel") continue;
-			const std::vector<TString>& tup = variables[i];
-			//std::cerr << "Adding variable: " << tup[1] << std::endl;
-			theTree->SetBranchAddress( tup[1], &var_val[cnt++] );
-		}
-
-		theTree->SetBranchAddress( "weight_70", &weight_70);
-		theTree->SetBranchAddress( "btweight_70", &btweight_70);
-		theTree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70);
-		theTree->SetBranchAddress( "analysis_channel", &analysis_channel);
-		//std::cerr << "--- Processing: " << theTree->GetEntries() << " events" << std::endl;
-		//TStopwatch sw;
-		//sw.Start();
-
-
-
-		Int_t nEvent = theTree->GetEntries();
-
-		for (Long64_t ievt=0; ievt<nEvent; ievt++) {
-			//if (ievt%10000 == 0) {
-			//	std::cerr << "--- ... Processing event: " << ievt << std::endl;
-			//}
-
-			theTree->GetEntry(ievt);
-			if (analysis_channel == 0) continue;
-
-			//theTree->Show(ievt);
-
-			Double_t mc_weight = weight_1btin_70*weight_70/btweight_70;
-			// --- Return the MVA outputs and fill into histograms
-			if (Use["MLP"]) {
-				Double_t MVA_MLP = reader->EvaluateMVA( "MLP method" );
-				if (MVA_MLP >= 0.9965) {
-					//std::cerr << "got one! " << mc_weight << std::endl; 
-					signal_mlp += mc_weight;
-				}
-			}
-
-			if (Use["BDTG"]) {
-				Double_t MVA_BDTG = reader->EvaluateMVA("BDTG method");	
-				//std::cerr << MVA_BDTG << std::endl;
-				if ((MVA_BDTG+1)/2.0 >= 0.95) {
-					//std::cerr << "got one!" << mc_weight << std::endl;
-					signal_bdtg += mc_weight;
-				}
-			}
-		}
-
-		// Get elapsed time
-		//sw.Stop();
-		theTree->ResetBranchAddresses();
-		std::cerr << "--- End of event loop: "; //sw.Print();
-		std::cerr << "==> TMVAClassificationApplication is done!" << std::endl << std::endl;
-
-
-		//if (ievt % 10000 == 0)
-		//	std::cerr << signal_mlp << " " << std::signal_bdtg < endl;
-	}
-
-	std::cerr << signal_mlp << " " << tot_bg_mlp << " " << signal_bdtg << " " << tot_bg_bdtg << std::endl;
+	// a single cut each: the lowest cut of a scan with one bin
+	SignificanceScan scan_mlp(0.9965, 1.0, 1), scan_bdtg(0.95, 1.0, 1);
+
+	// score the samples on one worker process per core
+	std::vector<SignificanceScan> scans;
+	scans.push_back(scan_mlp);
+	scans.push_back(scan_bdtg);
+	ReaderEvaluator evaluator(reader, var_val, background_branches, signal_branches);
+	if (Use["MLP"]) evaluator.AddMethod("MLP method", 0);
+	if (Use["BDTG"]) evaluator.AddMethod("BDTG method", 1, 0.5, 0.5); // (response+1)/2
+	ParallelEvaluation evaluation;
+	for (int bg = 0; bg < 10; bg++) evaluation.AddSample(background_cache[bg], false);
+	for (int s = 0; s < 2; s++) evaluation.AddSample(signal_cache[s], true);
+	if (!evaluation.Run(evaluator, scans)) return 1;
+	scan_mlp = scans[0];
+	scan_bdtg = scans[1];
+
+	std::cerr << scan_mlp.GetSignal(0) << " " << scan_mlp.GetBackground(0) << " "
+		<< scan_bdtg.GetSignal(0) << " " << scan_bdtg.GetBackground(0) << std::endl;
 	//get efficiency of methods, compare with current bests
 	if (Use["MLP"]) {
-		double sig = signal_mlp/sqrt(signal_mlp + tot_bg_mlp);
-		if (signal_mlp != 0) {
+		double sig = scan_mlp.GetSignificance(0);
+		if (scan_mlp.GetSignal(0) != 0) {
 			std::cerr << "MLP Significance: " << sig <<  std::endl;
 			rankings.insert(make_method_stats((1<<num_used)-1, sig, "MLP"));
 		}
 	}
 
 	if (Use["BDTG"]) {
-		double sig = signal_bdtg/sqrt(signal_bdtg + tot_bg_bdtg);
-		//std::cerr << tot_bg_bdtg << std::endl;
-		if (signal_bdtg != 0) {
+		double sig = scan_bdtg.GetSignificance(0);
+		if (scan_bdtg.GetSignal(0) != 0) {
 			std::cerr << "BDTG Significance: " << sig <<  std::endl;
 			rankings.insert(make_method_stats((1<<num_used)-1, sig, "BDTG"));
 		}
 	}
 
+	for (int s = 0; s < 2; s++) delete train_signal_cache[s];
+	for (int bg = 0; bg < 10; bg++) delete background_cache[bg];
+	for (int s = 0; s < 2; s++) delete signal_cache[s];
+
 	std::set<method_stats>::iterator it;
 	std::cout << "Best variables:" << std::endl;
 	for (it = rankings.begin(); it != rankings.end(); it++) {
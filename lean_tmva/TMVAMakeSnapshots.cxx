@@ -0,0 +1,73 @@
+/**********************************************************************************
+ * Writes the EventCache snapshots of the mini ntuples for the variables of a     *
+ * variable list file:                                                            *
+ *                                                                                *
+ *    ./TMVAMakeSnapshots cleaned-variables-no-jets.txt [snapshot directory]      *
+ *                                                                                *
+ * The snapshots are <directory>/nominal_{el,mu}/<sample>-<hash>.snap, the hash   *
+ * of the full name of the ROOT file (the directory is "snapshots" by default).   *
+ * TMVAClassificationCpp maps them instead of reading the ROOT files when they    *
+ * hold all of its variables and the ROOT files have not changed since.           *
+ **********************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TStopwatch.h"
+
+#include "EventCache.h"
+
+int main(int argc, char* argv[]) {
+	if (argc == 1) {
+		std::cerr << "Filename of input variables needed!" << std::endl;
+		return 0;
+	}
+	TString snapshot_dir = argc > 2 ? argv[2] : "snapshots";
+
+	std::vector<TString> branches;
+	std::fstream fin(argv[1], std::fstream::in);
+	std::vector<TString> inp(4); //var, title, unit, type.
+	while (fin >> inp[0] >> inp[1] >> inp[2] >> inp[3]) {
+		if (inp[1] == "analysis_channel") continue;
+		branches.push_back(inp[0]);
+	}
+
+	TString data_path = "/mnt/xrootdb/alister/MVA_studies/samples/";
+	const char* channels[2] = {"nominal_el", "nominal_mu"};
+	const char* samples[7] = {"tprime_650_1M", "tprime_650", "ttbar", "wjets", "zjets", "singletop", "diboson"};
+
+	int status = 0;
+	for (int c = 0; c < 2; c++) {
+		gSystem->mkdir(snapshot_dir + "/" + channels[c], kTRUE);
+		for (int s = 0; s < 7; s++) {
+			TString file = TString(channels[c]) + "/" + samples[s] + ".root";
+			TFile* input = TFile::Open(data_path + file, "READ");
+			TTree* tree = input ? (TTree*)input->Get("mini") : 0;
+			if (!tree) {
+				std::cerr << "Cannot read " << data_path + file << std::endl;
+				status = 1;
+				continue;
+			}
+
+			TStopwatch sw;
+			sw.Start();
+			EventCache* cache = EventCache::Decode(tree, branches);
+			TString snapshot = EventCache::GetSnapshotName(snapshot_dir, data_path + file);
+			if (!cache || !cache->WriteSnapshot(snapshot)) status = 1;
+			sw.Stop();
+			if (cache) std::cerr << "Wrote " << snapshot << ": " << cache->GetNEvents() << " events in "
+				<< sw.RealTime() << " s" << std::endl;
+			delete cache;
+
+			input->Close();
+			delete input;
+		}
+	}
+	return status;
+}
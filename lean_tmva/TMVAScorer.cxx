@@ -0,0 +1,141 @@
+/**********************************************************************************
+ * Executable: TMVAScorer                                                         *
+ *                                                                                *
+ * Scores events with the generated readers weights/TMVAClassification_*.class.C, *
+ * without ROOT: the events are read from a snapshot of EventCache or a CSV file  *
+ * and the responses are written as CSV, one column per method.                   *
+ *                                                                                *
+ *    ./compile_scorer.sh MLP BDTG                                                *
+ *    ./TMVAScorer -j 8 -o scores.csv MLP=mlp-variables.txt \                     *
+ *          BDTG=bdtg-variables.txt snapshots/nominal_el/ttbar.snap               *
+ *                                                                                *
+ * The variables of a method are the first word of each line of its file, in the *
+ * order of the training, as in the input variable files of the drivers; they are *
+ * the names of the input columns.                                                *
+ **********************************************************************************/
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "ScorerMethods.h"
+#include "ColumnInput.h"
+#include "ParallelScorer.h"
+
+double wall_seconds() {
+	struct timeval now;
+	gettimeofday(&now, 0);
+	return now.tv_sec + 1e-6*now.tv_usec;
+}
+
+int usage(const char* program) {
+	std::cerr << "usage: " << program << " [-j <threads>] [-o <output csv>] <method>=<variables file> [...] <input .snap or .csv>" << std::endl;
+	std::cerr << "methods compiled in:";
+	std::vector<std::string> methods = GetScorerMethods();
+	for (size_t i = 0; i < methods.size(); i++) std::cerr << " " << methods[i];
+	std::cerr << std::endl;
+	return 1;
+}
+
+int main(int argc, char* argv[]) {
+	double start = wall_seconds();
+
+	int num_threads = 0;
+	std::string output_name;
+	std::vector<std::string> method_names, variable_files;
+	std::string input_name;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) num_threads = atoi(argv[++i]);
+		else if (arg == "-o" && i + 1 < argc) output_name = argv[++i];
+		else if (arg.find('=') != std::string::npos) {
+			method_names.push_back(arg.substr(0, arg.find('=')));
+			variable_files.push_back(arg.substr(arg.find('=') + 1));
+		}
+		else if (input_name.empty()) input_name = arg;
+		else return usage(argv[0]);
+	}
+	if (method_names.empty() || input_name.empty()) return usage(argv[0]);
+
+	ColumnInput input;
+	if (!input.Open(input_name)) return 1;
+
+	// --- The readers, each on its variables; the scorer rows hold the union of them
+	std::vector<std::vector<std::string> > variables(method_names.size());
+	std::vector<std::string> columns;
+	for (size_t m = 0; m < method_names.size(); m++) {
+		std::ifstream fin(variable_files[m].c_str());
+		if (!fin) {
+			std::cerr << "Cannot read " << variable_files[m] << std::endl;
+			return 1;
+		}
+		std::string line, name;
+		while (std::getline(fin, line)) {
+			std::istringstream words(line);
+			if (words >> name) variables[m].push_back(name);
+		}
+		for (size_t v = 0; v < variables[m].size(); v++) {
+			if (std::find(columns.begin(), columns.end(), variables[m][v]) == columns.end()) columns.push_back(variables[m][v]);
+		}
+	}
+
+	std::vector<int> input_columns = input.GetIndices(columns);
+	for (size_t c = 0; c < columns.size(); c++) {
+		if (input_columns[c] < 0) {
+			std::cerr << "No column " << columns[c] << " in " << input_name << std::endl;
+			return 1;
+		}
+	}
+
+	FusedScorer scorer(columns);
+	std::vector<IClassifierReader*> readers;
+	for (size_t m = 0; m < method_names.size(); m++) {
+		IClassifierReader* reader = MakeScorerReader(method_names[m], variables[m]);
+		if (!reader) {
+			std::cerr << "Method " << method_names[m] << " is not compiled in" << std::endl;
+			return usage(argv[0]);
+		}
+		readers.push_back(reader);
+		if (!scorer.AddMethod(method_names[m], reader, variables[m])) return 1;
+	}
+	double booked = wall_seconds();
+
+	// --- Score all events
+	std::vector<double> scores(input.GetNEvents()*method_names.size());
+	ParallelScorer parallel(scorer, num_threads);
+	if (!parallel.Score(input, input_columns, scores.empty() ? 0 : &scores[0])) return 1;
+	double scored = wall_seconds();
+
+	// --- Write the responses
+	FILE* out = output_name.empty() ? stdout : fopen(output_name.c_str(), "w");
+	if (!out) {
+		std::cerr << "Cannot write " << output_name << std::endl;
+		return 1;
+	}
+	for (size_t m = 0; m < method_names.size(); m++) fprintf(out, m ? ",%s" : "%s", method_names[m].c_str());
+	fprintf(out, "\n");
+	for (size_t i = 0; i < input.GetNEvents(); i++) {
+		for (size_t m = 0; m < method_names.size(); m++) {
+			fprintf(out, m ? ",%.9g" : "%.9g", scores[i*method_names.size() + m]);
+		}
+		fprintf(out, "\n");
+	}
+	bool ok = ferror(out) == 0;
+	if (out != stdout) ok = fclose(out) == 0 && ok;
+	if (!ok) {
+		std::cerr << "Cannot write " << output_name << std::endl;
+		return 1;
+	}
+
+	for (size_t m = 0; m < readers.size(); m++) delete readers[m];
+
+	std::cerr << "Scored " << input.GetNEvents() << " events of " << input_name << ": setup " << booked - start
+		<< " s, scoring " << scored - booked << " s, output " << wall_seconds() - scored << " s" << std::endl;
+	return 0;
+}
@@ -0,0 +1,45 @@
+/* TMVAScorer: C interface of libTMVAScorer.so, the generated readers without ROOT
+ *
+ * A scorer is made for rows of the columns "columns"; each method added to it is
+ * one of the methods compiled into the library (see compile_scorer.sh and
+ * ScorerMethods.h), on input variables that are columns. Scoring runs on
+ * nThreads threads (0: one per online processor).
+ *
+ *    const char* columns[] = { "lep_pt", "Whad_pt", ... };
+ *    TMVAScorer* scorer = tmva_scorer_create( 7, columns );
+ *    tmva_scorer_add_method( scorer, "MLP", 7, columns );
+ *    tmva_scorer_score( scorer, rows, nEvents, 0, scores );   // scores[i*nMethods + m]
+ *    tmva_scorer_destroy( scorer );
+ */
+
+#ifndef TMVAScorer__def
+#define TMVAScorer__def
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TMVAScorer TMVAScorer;
+
+/* a scorer of rows of "nColumns" floats, the values of "columns" */
+TMVAScorer* tmva_scorer_create( int nColumns, const char* const* columns );
+
+/* add "method" on the input variables "inputVars"; 0 on success, -1 if the method
+ * is not compiled in or does not accept the variables */
+int tmva_scorer_add_method( TMVAScorer* scorer, const char* method, int nVars, const char* const* inputVars );
+
+int tmva_scorer_get_n_methods( const TMVAScorer* scorer );
+
+/* the responses of "nEvents" rows, row i at rows[i*nColumns], of method m in
+ * out[i*nMethods + m]; 0 on success */
+int tmva_scorer_score( const TMVAScorer* scorer, const float* rows, size_t nEvents, int nThreads, double* out );
+
+void tmva_scorer_destroy( TMVAScorer* scorer );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
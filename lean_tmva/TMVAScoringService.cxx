@@ -0,0 +1,151 @@
+/**********************************************************************************
+ * Executable: TMVAScoringService                                                 *
+ *                                                                                *
+ * Scores files with the newest libTMVAScorer.so under a watched directory and    *
+ * takes up a retrained one without a restart: the directory is polled on a       *
+ * background thread (see ModelRegistry.h), and each file is scored entirely by   *
+ * the model that was current when it started.                                    *
+ *                                                                                *
+ *    ./TMVAScoringService -j 8 -p 10 weights MLP=mlp-variables.txt < requests    *
+ *                                                                                *
+ * Each line of the standard input is "<input .snap or .csv> <output csv>"; one   *
+ * line "<output csv> <model> <events>" is written to the standard output per    *
+ * file scored. A new model is deployed by building it with compile_scorer.sh     *
+ * and copying the library to weights/<training>/libTMVAScorer.so.                *
+ **********************************************************************************/
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+#include "ColumnInput.h"
+#include "ModelRegistry.h"
+#include "ScorerLibrary.h"
+
+int usage(const char* program) {
+	std::cerr << "usage: " << program << " [-j <threads>] [-p <poll seconds>] <watched directory> <method>=<variables file> [...]" << std::endl;
+	return 1;
+}
+
+bool score_file(const ScoringModel& model, const std::vector<std::string>& method_names,
+		const std::string& input_name, const std::string& output_name, size_t& num_events) {
+	ColumnInput input;
+	if (!input.Open(input_name)) return false;
+	const std::vector<std::string>& columns = model.GetColumns();
+	std::vector<int> input_columns = input.GetIndices(columns);
+	for (size_t c = 0; c < columns.size(); c++) {
+		if (input_columns[c] < 0) {
+			std::cerr << "No column " << columns[c] << " in " << input_name << std::endl;
+			return false;
+		}
+	}
+
+	FILE* out = fopen(output_name.c_str(), "w");
+	if (!out) {
+		std::cerr << "Cannot write " << output_name << std::endl;
+		return false;
+	}
+	for (size_t m = 0; m < method_names.size(); m++) fprintf(out, m ? ",%s" : "%s", method_names[m].c_str());
+	fprintf(out, "\n");
+
+	// --- In batches, so that a large file does not hold all its rows at once
+	const size_t batch_size = 65536;
+	const size_t num_methods = model.GetNMethods();
+	std::vector<float> rows(batch_size*columns.size());
+	std::vector<double> scores(batch_size*num_methods);
+	bool ok = true;
+	for (size_t first = 0; ok && first < input.GetNEvents(); first += batch_size) {
+		size_t n = std::min(batch_size, input.GetNEvents() - first);
+		input.GetRows(input_columns, first, n, &rows[0]);
+		ok = model.Score(&rows[0], n, &scores[0]);
+		for (size_t i = 0; ok && i < n; i++) {
+			for (size_t m = 0; m < num_methods; m++) fprintf(out, m ? ",%.9g" : "%.9g", scores[i*num_methods + m]);
+			fprintf(out, "\n");
+		}
+	}
+	ok = ferror(out) == 0 && ok;
+	ok = fclose(out) == 0 && ok;
+	if (!ok) {
+		std::cerr << "Cannot score " << input_name << " into " << output_name << std::endl;
+		unlink(output_name.c_str());
+		return false;
+	}
+	num_events = input.GetNEvents();
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	int num_threads = 0;
+	double poll_seconds = 10;
+	std::string watch_dir;
+	std::vector<std::string> method_names, variable_files;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) num_threads = atoi(argv[++i]);
+		else if (arg == "-p" && i + 1 < argc) poll_seconds = atof(argv[++i]);
+		else if (arg.find('=') != std::string::npos) {
+			method_names.push_back(arg.substr(0, arg.find('=')));
+			variable_files.push_back(arg.substr(arg.find('=') + 1));
+		}
+		else if (watch_dir.empty()) watch_dir = arg;
+		else return usage(argv[0]);
+	}
+	if (method_names.empty() || watch_dir.empty()) return usage(argv[0]);
+
+	std::vector<std::vector<std::string> > variables(method_names.size());
+	for (size_t m = 0; m < method_names.size(); m++) {
+		std::ifstream fin(variable_files[m].c_str());
+		if (!fin) {
+			std::cerr << "Cannot read " << variable_files[m] << std::endl;
+			return 1;
+		}
+		std::string line, name;
+		while (std::getline(fin, line)) {
+			std::istringstream words(line);
+			if (words >> name) variables[m].push_back(name);
+		}
+	}
+
+	// --- The first model is loaded before any request is read
+	ScorerLibraryLoader loader(method_names, variables, num_threads);
+	ModelRegistry registry(watch_dir, "libTMVAScorer.so", loader);
+	for (int i = 0; i < 5 && registry.GetCurrentPath().empty(); i++) {
+		if (!registry.Poll()) sleep(1);
+	}
+	if (registry.GetCurrentPath().empty()) {
+		std::cerr << "No usable libTMVAScorer.so under " << watch_dir << std::endl;
+		return 1;
+	}
+	if (!registry.Start(poll_seconds)) return 1;
+
+	int num_failed = 0;
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		std::istringstream words(line);
+		std::string input_name, output_name;
+		if (!(words >> input_name) || input_name[0] == '#') continue;
+		if (!(words >> output_name)) {
+			std::cerr << "No output for " << input_name << std::endl;
+			num_failed++;
+			continue;
+		}
+
+		std::string model_path;
+		const ScoringModel* model = registry.Acquire(&model_path);
+		size_t num_events = 0;
+		if (score_file(*model, method_names, input_name, output_name, num_events)) {
+			std::cout << output_name << " " << model_path << " " << num_events << std::endl;
+		}
+		else num_failed++;
+		registry.Release(model);
+	}
+
+	registry.Stop();
+	return num_failed ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+// VariableMask: a subset of the candidate variables of a driver, as a fixed-size bitset
+//
+// Bit i stands for line i of the variable list. The capacity, kCapacity variables,
+// is fixed at compile time so that masks are plain values (no allocation) that
+// compare, hash and count set bits word by word. As text, in the journals and
+// outputs, a mask is written in hexadecimal with a leading "0x"; plain decimal
+// numbers, the long long masks of older journals, are read as well.
+//
+//    VariableMask choice;
+//    choice.Set( 3 );
+//    for (int i = choice.First(); i >= 0; i = choice.Next( i )) std::cerr << variables[i][1] << std::endl;
+//    std::string text = choice.ToString();   // "0x8"
+
+#ifndef VariableMask__def
+#define VariableMask__def
+
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+
+class VariableMask {
+
+ public:
+
+   enum { kNWords = 4, kCapacity = 64*kNWords };
+
+   VariableMask() { for (int w = 0; w < kNWords; w++) fWords[w] = 0; }
+
+   void Set( int i )        { fWords[i >> 6] |= 1ULL << (i & 63); }
+   void Reset( int i )      { fWords[i >> 6] &= ~(1ULL << (i & 63)); }
+   void Flip( int i )       { fWords[i >> 6] ^= 1ULL << (i & 63); }
+   bool Test( int i ) const { return (fWords[i >> 6] >> (i & 63)) & 1; }
+
+   bool IsEmpty() const;
+   int  Count() const;
+
+   // first set bit, and the set bit after i; -1 if there is none
+   int First() const { return Next( -1 ); }
+   int Next( int i ) const;
+
+   unsigned long long Hash() const;
+
+   VariableMask operator|( const VariableMask& other ) const;
+   VariableMask operator&( const VariableMask& other ) const;
+   VariableMask operator^( const VariableMask& other ) const;
+   bool operator==( const VariableMask& other ) const;
+   bool operator!=( const VariableMask& other ) const { return !(*this == other); }
+   bool operator<( const VariableMask& other ) const;
+
+   std::string ToString() const;
+   // false if "text" is not a mask of at most kCapacity bits
+   static bool FromString( const std::string& text, VariableMask& mask );
+
+ private:
+
+   unsigned long long fWords[kNWords];
+};
+
+//_______________________________________________________________________
+inline bool VariableMask::IsEmpty() const
+{
+   for (int w = 0; w < kNWords; w++) {
+      if (fWords[w]) return false;
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline int VariableMask::Count() const
+{
+   int count = 0;
+   for (int w = 0; w < kNWords; w++) count += __builtin_popcountll( fWords[w] );
+   return count;
+}
+
+//_______________________________________________________________________
+inline int VariableMask::Next( int i ) const
+{
+   int bit = i + 1;
+   if (bit >= kCapacity) return -1;
+   int w = bit >> 6;
+   unsigned long long word = fWords[w] & (~0ULL << (bit & 63));
+   while (word == 0) {
+      if (++w == kNWords) return -1;
+      word = fWords[w];
+   }
+   return (w << 6) + __builtin_ctzll( word );
+}
+
+//_______________________________________________________________________
+inline unsigned long long VariableMask::Hash() const
+{
+   unsigned long long hash = 14695981039346656037ULL;
+   for (int w = 0; w < kNWords; w++) {
+      hash ^= fWords[w];
+      hash *= 1099511628211ULL;
+      hash ^= hash >> 29;
+   }
+   return hash;
+}
+
+//_______________________________________________________________________
+inline VariableMask VariableMask::operator|( const VariableMask& other ) const
+{
+   VariableMask mask;
+   for (int w = 0; w < kNWords; w++) mask.fWords[w] = fWords[w] | other.fWords[w];
+   return mask;
+}
+
+//_______________________________________________________________________
+inline VariableMask VariableMask::operator&( const VariableMask& other ) const
+{
+   VariableMask mask;
+   for (int w = 0; w < kNWords; w++) mask.fWords[w] = fWords[w] & other.fWords[w];
+   return mask;
+}
+
+//_______________________________________________________________________
+inline VariableMask VariableMask::operator^( const VariableMask& other ) const
+{
+   VariableMask mask;
+   for (int w = 0; w < kNWords; w++) mask.fWords[w] = fWords[w] ^ other.fWords[w];
+   return mask;
+}
+
+//_______________________________________________________________________
+inline bool VariableMask::operator==( const VariableMask& other ) const
+{
+   for (int w = 0; w < kNWords; w++) {
+      if (fWords[w] != other.fWords[w]) return false;
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool VariableMask::operator<( const VariableMask& other ) const
+{
+   // as numbers, so that masks of the first 64 variables sort as their long long did
+   for (int w = kNWords - 1; w >= 0; w--) {
+      if (fWords[w] != other.fWords[w]) return fWords[w] < other.fWords[w];
+   }
+   return false;
+}
+
+//_______________________________________________________________________
+inline std::string VariableMask::ToString() const
+{
+   std::string text = "0x";
+   bool leading = true;
+   for (int w = kNWords - 1; w >= 0; w--) {
+      char word[17];
+      snprintf( word, sizeof(word), leading ? "%llx" : "%016llx", fWords[w] );
+      if (leading && fWords[w] == 0 && w > 0) continue;
+      text += word;
+      leading = false;
+   }
+   return text;
+}
+
+//_______________________________________________________________________
+inline bool VariableMask::FromString( const std::string& text, VariableMask& mask )
+{
+   mask = VariableMask();
+   bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+   if (text.empty()) return false;
+   for (size_t i = hex ? 2 : 0; i < text.size(); i++) {
+      if (!(hex ? isxdigit( text[i] ) : isdigit( text[i] ))) return false;
+   }
+   if (hex) {
+      std::string digits = text.substr( 2 );
+      if (digits.size() > 16*kNWords) return false;
+      for (int w = 0; w < kNWords && !digits.empty(); w++) {
+         size_t length = digits.size() < 16 ? digits.size() : 16;
+         std::string word = digits.substr( digits.size() - length );
+         digits.erase( digits.size() - length );
+         mask.fWords[w] = strtoull( word.c_str(), 0, 16 );
+      }
+      return true;
+   }
+   // the long long masks of older journals
+   if (text.size() > 19) return false;
+   mask.fWords[0] = strtoull( text.c_str(), 0, 10 );
+   return true;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Build the ROOT-free scorer TMVAScorer and libTMVAScorer.so from the generated
+# readers of the methods given, e.g. ./compile_scorer.sh MLP BDTG
+# TMVAScoringService loads any libTMVAScorer.so at run time, without methods.
+# A BDT or BDTG with node tables from generate_forest.py is built from those.
+flags=""
+sources=""
+for method in "$@"; do
+	flags="$flags -DSCORER_$method"
+	if [ -f weights/TMVAClassification_$method.forest.h ]; then
+		flags="$flags -DSCORER_${method}_FOREST"
+		sources="$sources `ls weights/TMVAClassification_$method.forest_*.C`"
+	fi
+done
+g++ -std=c++0x -pthread -m64 -Wall -Wextra -O3 $flags TMVAScorer.cxx $sources -o TMVAScorer || exit 1
+g++ -std=c++0x -pthread -m64 -Wall -Wextra -O3 -fPIC -shared $flags libTMVAScorer.cxx $sources -o libTMVAScorer.so || exit 1
+g++ -std=c++0x -pthread -m64 -Wall -Wextra -O3 TMVAScoringService.cxx -ldl -o TMVAScoringService
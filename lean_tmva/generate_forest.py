@@ -0,0 +1,438 @@
+#!/usr/bin/python
+#
+# Compile the decision trees of a BDT or BDTG reader class into node tables.
+#
+# usage: python generate_forest.py [-q] weights/TMVAClassification_BDTG.class.C [nParts]
+#
+# Reads the "NN(...)" trees that MethodBase::MakeClass writes into Initialize(),
+# pads every tree to a complete tree of depth MaxDepth and writes
+#
+#   weights/TMVAClassification_BDTG.forest.h     class ReadBDTGForest
+#   weights/TMVAClassification_BDTG.forest_<k>.C node tables of part k, k < nParts
+#
+# ReadBDTGForest has the same constructor and IClassifierReader interface as
+# ReadBDTG, but its trees are static const arrays: construction allocates nothing
+# and an event walks each tree in MaxDepth branch-free steps. The parts compile
+# independently, so build them in parallel and link them together, e.g.
+#
+#   g++ -O2 -c weights/TMVAClassification_BDTG.forest_*.C
+#
+# Responses are identical to ReadBDTG: the cut and leaf values are copied
+# literally and the trees are summed in their original order.
+#
+# With -q (quantized thresholds) the distinct cut values of each variable are
+# stored once, sorted, and the nodes hold the rank of their cut instead of its
+# value, as an 8-bit id (16-bit if a variable has more than 256 distinct cuts).
+# Each input value is mapped once per event to its bin, the number of cuts of
+# the variable below it, and the trees compare bins: bin > rank exactly when
+# x > cut, so the responses stay identical to ReadBDTG.
+
+import os
+import re
+import sys
+
+
+def parse_forest(text):
+    # return [(boost weight, tree)], a tree is a leaf (value) or a node
+    # (selector, cut, pass subtree, fail subtree); "pass" means x[selector] > cut
+    body = text[text.index("::Initialize()"):]
+    body = body[:body.index("return;")]
+    weights = re.findall(r"fBoostWeights\.push_back\(\s*([^)]+?)\s*\);", body)
+    tokens = re.findall(r"NN|\(|\)|,|[^\s(),]+", body[body.index("fForest.push_back"):])
+    pos = [0]
+
+    def take():
+        tok = tokens[pos[0]]
+        pos[0] += 1
+        return tok
+
+    def node():
+        tok = take()
+        if tok == "0":
+            return None
+        assert tok == "NN" and take() == "("
+        left = node()
+        assert take() == ","
+        right = node()
+        args = []
+        while True:
+            assert take() == ","
+            args.append(take())
+            if len(args) == 6:
+                break
+        assert take() == ")"
+        selector, cut, cutType, nodeType, purity, response = args
+        if left is None:
+            return ("leaf", nodeType, response)
+        # cut type 1: events above the cut go right, otherwise they go left
+        if cutType == "1":
+            return ("node", int(selector), cut, right, left)
+        return ("node", int(selector), cut, left, right)
+
+    trees = []
+    while pos[0] < len(tokens):
+        if tokens[pos[0]] == "NN":
+            trees.append(node())
+        else:
+            pos[0] += 1
+    assert len(trees) == len(weights)
+    return list(zip(weights, trees))
+
+
+def depth(tree):
+    if tree[0] == "leaf":
+        return 0
+    return 1 + max(depth(tree[3]), depth(tree[4]))
+
+
+def fill(tree, maxDepth, leafValue, selectors, cuts, leaves, i=0):
+    # store "tree" at heap index i: node i has its fail daughter at 2i+1 and its
+    # pass daughter at 2i+2; leaves above the last level are replicated downwards
+    nInternal = 2**maxDepth - 1
+    if i >= nInternal:
+        leaves[i - nInternal] = leafValue(tree)
+        return
+    if tree[0] == "leaf":
+        selectors[i], cuts[i] = "0", None
+        fill(tree, maxDepth, leafValue, selectors, cuts, leaves, 2*i + 1)
+        fill(tree, maxDepth, leafValue, selectors, cuts, leaves, 2*i + 2)
+        return
+    selectors[i], cuts[i] = str(tree[1]), tree[2]
+    fill(tree[4], maxDepth, leafValue, selectors, cuts, leaves, 2*i + 1)
+    fill(tree[3], maxDepth, leafValue, selectors, cuts, leaves, 2*i + 2)
+
+
+QUANTIZE_DECL = """
+   // bin of each input value: the number of distinct cut values of its variable
+   // below it, so that bins[ivar] > rank(cut) exactly when iV[ivar] > cut
+   void Quantize( const double* iV, size_t nEvents, unsigned short* bins ) const;
+"""
+
+QUANTIZE_DEF = """
+//_______________________________________________________________________
+inline void %(cls)s::Quantize( const double* iV, size_t nEvents, unsigned short* bins ) const
+{
+   for (size_t ievt = 0; ievt < nEvents; ievt++) {
+      for (int ivar = 0; ivar < %(nVars)d; ivar++) {
+         const double* first = %(cls)s_Cuts + %(cls)s_CutOffset[ivar];
+         const double* last  = %(cls)s_Cuts + %(cls)s_CutOffset[ivar+1];
+         bins[ievt*%(nVars)d + ivar] = std::lower_bound( first, last, iV[ievt*%(nVars)d + ivar] ) - first;
+      }
+   }
+}
+"""
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != "-q"]
+    quantize = len(args) < len(sys.argv) - 1
+    if len(args) < 1:
+        print("usage: %s [-q] <TMVAClassification_X.class.C> [nParts]" % sys.argv[0])
+        sys.exit(1)
+    classFile = args[0]
+    nParts = int(args[1]) if len(args) > 1 else 8
+    text = open(classFile).read()
+
+    method = re.search(r"^// Class: Read(\w+)", text, re.M).group(1)
+    className = "Read%sForest" % method
+    grad = "GetResponse()" in text[text.index("::GetMvaValue__"):text.index("::Initialize()")]
+    inputVars = re.search(r"const char\* inputVars\[\] = \{(.*)\};", text).group(1)
+    nVars = int(re.search(r"fNvars\( (\d+) \)", text).group(1))
+    normalised = re.search(r"fIsNormalised\( (\w+) \)", text).group(1)
+    ranges = re.findall(r"^\s*(fV(?:min|max)\[\d+\] = .*;)$", text, re.M)
+    interface = re.search(r"^#ifndef IClassifierReader__def$.*?^#endif$", text, re.M | re.S).group(0)
+
+    forest = parse_forest(text)
+    maxDepth = max(int(re.search(r'^MaxDepth: "(\d+)"', text, re.M).group(1)),
+                   max(depth(tree) for w, tree in forest))
+    nInternal, nLeaves = 2**maxDepth - 1, 2**maxDepth
+    nTrees = len(forest)
+    nParts = max(1, min(nParts, nTrees))
+
+    if grad:
+        leafValue = lambda leaf: leaf[2]
+        norm = None
+    else:
+        # AdaBoost: boost weight * node type, normalised by the sum of the weights
+        leafValue = None
+        norm = 0.0
+        for w, tree in forest:
+            norm += float(w)
+
+    base = os.path.splitext(os.path.splitext(classFile)[0])[0] if classFile.endswith(".class.C") else classFile
+    header = base + ".forest.h"
+    guard = className + "__def"
+    first = [nTrees*k//nParts for k in range(nParts + 1)]
+
+    # types of the node tables and of the values the trees are walked with
+    selectorType, cutType, inputType = "int", "double", "double"
+    if quantize:
+        cutValues = [set() for ivar in range(nVars)]
+
+        def collect(tree):
+            if tree[0] == "node":
+                cutValues[tree[1]].add(float(tree[2]))
+                collect(tree[3])
+                collect(tree[4])
+        for w, tree in forest:
+            collect(tree)
+        cutValues = [sorted(v) for v in cutValues]
+        rank = [dict((c, i) for i, c in enumerate(v)) for v in cutValues]
+        selectorType, inputType = "unsigned char", "unsigned short"
+        cutType = "unsigned char" if max(len(v) for v in cutValues) <= 256 else "unsigned short"
+
+    for k in range(nParts):
+        out = open("%s.forest_%d.C" % (base, k), "w")
+        out.write("// Trees %d to %d of %s, generated by generate_forest.py from %s\n\n"
+                  % (first[k], first[k+1] - 1, className, os.path.basename(classFile)))
+        out.write('#include "%s"\n\n' % os.path.basename(header))
+        n = first[k+1] - first[k]
+        selectorRows, cutRows, leafRows = [], [], []
+        for w, tree in forest[first[k]:first[k+1]]:
+            selectors, cuts, leaves = [None]*nInternal, [None]*nInternal, [None]*nLeaves
+            fn = leafValue or (lambda leaf, w=w: repr(float(w)*int(leaf[1])))
+            fill(tree, maxDepth, fn, selectors, cuts, leaves)
+            if quantize:
+                cuts = [str(rank[int(sel)][float(cut)]) if cut else "0" for sel, cut in zip(selectors, cuts)]
+            else:
+                cuts = [cut or "0" for cut in cuts]
+            selectorRows.append("   " + ", ".join(selectors))
+            cutRows.append("   " + ", ".join(cuts))
+            leafRows.append("   " + ", ".join(leaves))
+        if quantize and k == 0:
+            cutOffset = [0]
+            for v in cutValues:
+                cutOffset.append(cutOffset[-1] + len(v))
+            out.write("extern const double %s_Cuts[%d] = {\n%s };\n" % (className, cutOffset[-1],
+                      ",\n".join("   " + ", ".join(repr(c) for c in v) for v in cutValues if v)))
+            out.write("extern const int    %s_CutOffset[%d] = { %s };\n\n" % (className, nVars + 1,
+                      ", ".join(str(i) for i in cutOffset)))
+        out.write("static const %-6s kSelector[%d*%d] = {\n%s };\n" % (selectorType, n, nInternal, ",\n".join(selectorRows)))
+        out.write("static const %-6s kCut[%d*%d] = {\n%s };\n" % (cutType, n, nInternal, ",\n".join(cutRows)))
+        out.write("static const double kLeaf[%d*%d] = {\n%s };\n\n" % (n, nLeaves, ",\n".join(leafRows)))
+        out.write("void %s_Part%d( const %s* iV, size_t nEvents, double* sum )\n{\n" % (className, k, inputType))
+        out.write("   %sWalk( kSelector, kCut, kLeaf, %d, iV, nEvents, sum );\n}\n" % (className, n))
+        out.close()
+
+    out = open(header, "w")
+    out.write("""// Class: %(cls)s
+// Generated by generate_forest.py from %(src)s
+//
+// The %(nTrees)d trees of Read%(method)s as complete depth-%(depth)d node tables,
+// split over %(base)s.forest_0.C ... %(base)s.forest_%(last)d.C
+// which must be compiled and linked with the code including this header.
+
+#include <vector>
+#include <cmath>
+#include <string>
+#include <iostream>
+%(includes)s
+%(interface)s
+
+#ifndef %(guard)s
+#define %(guard)s
+
+// add the leaf values of "nTrees" trees to sum[ievt] for the "nEvents" events
+// iV[ievt*%(nVars)d], ...; node i of a tree goes to 2i+1 if the cut fails, 2i+2 if it passes
+inline void %(cls)sWalk( const %(selectorType)s* selector, const %(cutType)s* cut, const double* leaf, int nTrees,
+                       const %(inputType)s* iV, size_t nEvents, double* sum )
+{
+   for (int itree = 0; itree < nTrees; itree++, selector += %(nInternal)d, cut += %(nInternal)d, leaf += %(nLeaves)d) {
+      for (size_t ievt = 0; ievt < nEvents; ievt++) {
+         const %(inputType)s* x = iV + ievt*%(nVars)d;
+         int inode = 0;
+         for (int d = 0; d < %(depth)d; d++) inode = 2*inode + 1 + (x[selector[inode]] > cut[inode]);
+         sum[ievt] += leaf[inode - %(nInternal)d];
+      }
+   }
+}
+
+""" % dict(cls=className, src=os.path.basename(classFile), nTrees=nTrees, method=method, depth=maxDepth,
+           base=os.path.basename(base), last=nParts - 1, interface=interface, guard=guard, nVars=nVars,
+           nInternal=nInternal, nLeaves=nLeaves, selectorType=selectorType, cutType=cutType, inputType=inputType,
+           includes="#include <algorithm>\n" if quantize else ""))
+    if quantize:
+        out.write("// sorted distinct cut values of variable ivar: %s_Cuts[%s_CutOffset[ivar]], ...\n"
+                  % (className, className))
+        out.write("extern const double %s_Cuts[];\n" % className)
+        out.write("extern const int    %s_CutOffset[%d];\n\n" % (className, nVars + 1))
+    for k in range(nParts):
+        out.write("void %s_Part%d( const %s* iV, size_t nEvents, double* sum );\n" % (className, k, inputType))
+
+    out.write("""
+class %(cls)s : public IClassifierReader {
+
+ public:
+
+   // constructor
+   %(cls)s( std::vector<std::string>& theInputVars )
+      : IClassifierReader(),
+        fClassName( "%(cls)s" ),
+        fNvars( %(nVars)d ),
+        fIsNormalised( %(normalised)s )
+   {
+      // the training input variables
+      const char* inputVars[] = {%(inputVars)s};
+
+      // sanity checks
+      if (theInputVars.size() <= 0) {
+         std::cout << "Problem in class \\"" << fClassName << "\\": empty input vector" << std::endl;
+         fStatusIsClean = false;
+      }
+
+      if (theInputVars.size() != fNvars) {
+         std::cout << "Problem in class \\"" << fClassName << "\\": mismatch in number of input values: "
+                   << theInputVars.size() << " != " << fNvars << std::endl;
+         fStatusIsClean = false;
+      }
+
+      // validate input variables
+      for (size_t ivar = 0; ivar < theInputVars.size(); ivar++) {
+         if (theInputVars[ivar] != inputVars[ivar]) {
+            std::cout << "Problem in class \\"" << fClassName << "\\": mismatch in input variable names" << std::endl
+                      << " for variable [" << ivar << "]: " << theInputVars[ivar].c_str() << " != " << inputVars[ivar] << std::endl;
+            fStatusIsClean = false;
+         }
+      }
+
+      // initialize min and max vectors (for normalisation)
+%(ranges)s
+   }
+
+   // the classifier response
+   // "inputValues" is a vector of input values in the same order as the
+   // variables given to the constructor
+   double GetMvaValue( const std::vector<double>& inputValues ) const;
+
+   // the classifier response of a batch of events
+   // "rows" holds the input values of event i at rows[i*stride], in the same
+   // order as the variables given to the constructor
+   void GetMvaValues( const float* rows, size_t nEvents, size_t stride, double* out ) const;
+
+   // the steps of GetMvaValues, see IClassifierReader
+   void TransformInputs( const float* rows, size_t nEvents, size_t stride, double* iV ) const;
+   void GetMvaValuesTransformed( const double* iV, size_t nEvents, double* out ) const;
+   std::vector<double> GetTransformParameters() const;
+
+ private:
+
+   // sum the leaf values of all trees, in the original tree order
+   void SumForest( const %(inputType)s* iV, size_t nEvents, double* sum ) const;
+   double Response( double sum ) const { return %(response)s; }
+%(quantizeDecl)s
+   const char* fClassName;
+   const size_t fNvars;
+
+   // normalisation of input variables
+   const bool fIsNormalised;
+   bool IsNormalised() const { return fIsNormalised; }
+   double fVmin[%(nVars)d];
+   double fVmax[%(nVars)d];
+   double NormVariable( double x, double xmin, double xmax ) const {
+      // normalise to output range: [-1, 1]
+      return 2*(x - xmin)/(xmax - xmin) - 1.0;
+   }
+};
+
+//_______________________________________________________________________
+inline void %(cls)s::SumForest( const %(inputType)s* iV, size_t nEvents, double* sum ) const
+{
+   for (size_t ievt = 0; ievt < nEvents; ievt++) sum[ievt] = 0;
+%(calls)s
+}
+%(quantizeDef)s
+//_______________________________________________________________________
+inline double %(cls)s::GetMvaValue( const std::vector<double>& inputValues ) const
+{
+   // classifier response, sanity check first
+   if (!IsStatusClean()) {
+      std::cout << "Problem in class \\"" << fClassName << "\\": cannot return classifier response"
+                << " because status is dirty" << std::endl;
+      return 0;
+   }
+
+   double iV[%(nVars)d];
+   for (int ivar = 0; ivar < %(nVars)d; ivar++) {
+      iV[ivar] = IsNormalised() ? NormVariable( inputValues[ivar], fVmin[ivar], fVmax[ivar] ) : inputValues[ivar];
+   }
+%(quantizeOne)s   double sum;
+   SumForest( %(forestInput)s, 1, &sum );
+   return Response( sum );
+}
+
+//_______________________________________________________________________
+inline void %(cls)s::GetMvaValues( const float* rows, size_t nEvents, size_t stride, double* out ) const
+{
+   // classifier response of a batch of events, sanity check once for the batch
+   if (!IsStatusClean()) {
+      std::cout << "Problem in class \\"" << fClassName << "\\": cannot return classifier response"
+                << " because status is dirty" << std::endl;
+      for (size_t ievt = 0; ievt < nEvents; ievt++) out[ievt] = 0;
+      return;
+   }
+
+   // events are transformed and scored in blocks
+   const size_t nBlock = 64;
+   double iV[nBlock*%(nVars)d];
+   for (size_t first = 0; first < nEvents; first += nBlock) {
+      size_t n = nEvents - first < nBlock ? nEvents - first : nBlock;
+      TransformInputs( rows + first*stride, n, stride, iV );
+      GetMvaValuesTransformed( iV, n, out + first );
+   }
+}
+
+//_______________________________________________________________________
+inline void %(cls)s::TransformInputs( const float* rows, size_t nEvents, size_t stride, double* iV ) const
+{
+   // normalisation of the input variables
+   for (size_t ievt = 0; ievt < nEvents; ievt++) {
+      const float* row = rows + ievt*stride;
+      double* x = iV + ievt*%(nVars)d;
+      for (int ivar = 0; ivar < %(nVars)d; ivar++) {
+         x[ivar] = IsNormalised() ? NormVariable( row[ivar], fVmin[ivar], fVmax[ivar] ) : row[ivar];
+      }
+   }
+}
+
+//_______________________________________________________________________
+inline std::vector<double> %(cls)s::GetTransformParameters() const
+{
+   // normalisation ranges, if the input variables are normalised
+   std::vector<double> par( 1, IsNormalised() );
+   if (IsNormalised()) {
+      par.insert( par.end(), fVmin, fVmin + %(nVars)d );
+      par.insert( par.end(), fVmax, fVmax + %(nVars)d );
+   }
+   return par;
+}
+
+//_______________________________________________________________________
+inline void %(cls)s::GetMvaValuesTransformed( const double* iV, size_t nEvents, double* out ) const
+{
+   // events are scored in blocks, each part of the forest is walked once per block
+   const size_t nBlock = 64;
+%(quantizeBlockDecl)s   double sum[nBlock];
+   for (size_t first = 0; first < nEvents; first += nBlock) {
+      size_t n = nEvents - first < nBlock ? nEvents - first : nBlock;
+%(quantizeBlock)s      SumForest( %(forestBlockInput)s, n, sum );
+      for (size_t ievt = 0; ievt < n; ievt++) out[first + ievt] = Response( sum[ievt] );
+   }
+}
+
+#endif
+""" % dict(cls=className, nVars=nVars, normalised=normalised, inputVars=inputVars,
+           ranges="\n".join("      " + r for r in ranges),
+           response="2.0/(1.0+exp(-2.0*sum))-1.0" if grad else "sum / %r" % norm,
+           calls="\n".join("   %s_Part%d( iV, nEvents, sum );" % (className, k) for k in range(nParts)),
+           inputType=inputType, forestInput="bins" if quantize else "iV",
+           quantizeDecl=QUANTIZE_DECL if quantize else "",
+           quantizeDef=(QUANTIZE_DEF % dict(cls=className, nVars=nVars)) if quantize else "",
+           quantizeOne=("   unsigned short bins[%d];\n   Quantize( iV, 1, bins );\n" % nVars) if quantize else "",
+           quantizeBlockDecl=("   unsigned short bins[nBlock*%d];\n" % nVars) if quantize else "",
+           quantizeBlock="      Quantize( iV + first*%d, n, bins );\n" % nVars if quantize else "",
+           forestBlockInput="bins" if quantize else "iV + first*%d" % nVars))
+    out.close()
+
+
+if __name__ == "__main__":
+    main()
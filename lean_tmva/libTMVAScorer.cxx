@@ -0,0 +1,66 @@
+// libTMVAScorer.so: the C interface of TMVAScorer.h over FusedScorer and ParallelScorer
+//
+// Built by compile_scorer.sh with the same methods as the TMVAScorer executable.
+
+#include <vector>
+#include <string>
+
+#include "ScorerMethods.h"
+#include "ParallelScorer.h"
+#include "TMVAScorer.h"
+
+struct TMVAScorer {
+   TMVAScorer( const std::vector<std::string>& columns ) : scorer( columns ) {}
+   ~TMVAScorer() { for (size_t m = 0; m < readers.size(); m++) delete readers[m]; }
+
+   FusedScorer                     scorer;
+   std::vector<IClassifierReader*> readers;
+   size_t                          nColumns;
+};
+
+//_______________________________________________________________________
+TMVAScorer* tmva_scorer_create( int nColumns, const char* const* columns )
+{
+   if (nColumns <= 0) return 0;
+   TMVAScorer* scorer = new TMVAScorer( std::vector<std::string>( columns, columns + nColumns ) );
+   scorer->nColumns = nColumns;
+   return scorer;
+}
+
+//_______________________________________________________________________
+int tmva_scorer_add_method( TMVAScorer* scorer, const char* method, int nVars, const char* const* inputVars )
+{
+   if (!scorer || nVars <= 0) return -1;
+   std::vector<std::string> vars( inputVars, inputVars + nVars );
+   IClassifierReader* reader = MakeScorerReader( method, vars );
+   if (!reader) {
+      std::cout << "Problem in libTMVAScorer: method \"" << method << "\" is not compiled in" << std::endl;
+      return -1;
+   }
+   if (!scorer->scorer.AddMethod( method, reader, vars )) {
+      delete reader;
+      return -1;
+   }
+   scorer->readers.push_back( reader );
+   return 0;
+}
+
+//_______________________________________________________________________
+int tmva_scorer_get_n_methods( const TMVAScorer* scorer )
+{
+   return scorer ? scorer->scorer.GetNMethods() : 0;
+}
+
+//_______________________________________________________________________
+int tmva_scorer_score( const TMVAScorer* scorer, const float* rows, size_t nEvents, int nThreads, double* out )
+{
+   if (!scorer) return -1;
+   ParallelScorer parallel( scorer->scorer, nThreads );
+   return parallel.Score( rows, nEvents, scorer->nColumns, out ) ? 0 : -1;
+}
+
+//_______________________________________________________________________
+void tmva_scorer_destroy( TMVAScorer* scorer )
+{
+   delete scorer;
+}
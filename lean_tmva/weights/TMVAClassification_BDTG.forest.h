@@ -0,0 +1,268 @@
+// Class: ReadBDTGForest
+// Generated by generate_forest.py from TMVAClassification_BDTG.class.C
+//
+// The 2000 trees of ReadBDTG as complete depth-4 node tables,
+// split over TMVAClassification_BDTG.forest_0.C ... TMVAClassification_BDTG.forest_7.C
+// which must be compiled and linked with the code including this header.
+
+#include <vector>
+#include <cmath>
+#include <string>
+#include <iostream>
+
+#ifndef IClassifierReader__def
+#define IClassifierReader__def
+
+class IClassifierReader {
+
+ public:
+
+   // constructor
+   IClassifierReader() : fStatusIsClean( true ) {}
+   virtual ~IClassifierReader() {}
+
+   // return classifier response
+   virtual double GetMvaValue( const std::vector<double>& inputValues ) const = 0;
+
+   // return classifier responses of "nEvents" events in "out"; the input values of
+   // event i are rows[i*stride], ..., in the same order as given to the constructor
+   virtual void GetMvaValues( const float* rows, size_t nEvents, size_t stride, double* out ) const = 0;
+
+   // the two steps of GetMvaValues: the normalisation and transformation of the input
+   // values of event i into iV[i*nvar], ..., and the classifier responses of such values
+   virtual void TransformInputs( const float* rows, size_t nEvents, size_t stride, double* iV ) const = 0;
+   virtual void GetMvaValuesTransformed( const double* iV, size_t nEvents, double* out ) const = 0;
+
+   // the parameters of TransformInputs: readers with the same input variables and
+   // transform parameters can share the transformed values of one TransformInputs call
+   virtual std::vector<double> GetTransformParameters() const = 0;
+
+   // returns classifier status
+   bool IsStatusClean() const { return fStatusIsClean; }
+
+ protected:
+
+   bool fStatusIsClean;
+};
+
+#endif
+
+#ifndef ReadBDTGForest__def
+#define ReadBDTGForest__def
+
+// add the leaf values of "nTrees" trees to sum[ievt] for the "nEvents" events
+// iV[ievt*13], ...; node i of a tree goes to 2i+1 if the cut fails, 2i+2 if it passes
+inline void ReadBDTGForestWalk( const int* selector, const double* cut, const double* leaf, int nTrees,
+                       const double* iV, size_t nEvents, double* sum )
+{
+   for (int itree = 0; itree < nTrees; itree++, selector += 15, cut += 15, leaf += 16) {
+      for (size_t ievt = 0; ievt < nEvents; ievt++) {
+         const double* x = iV + ievt*13;
+         int inode = 0;
+         for (int d = 0; d < 4; d++) inode = 2*inode + 1 + (x[selector[inode]] > cut[inode]);
+         sum[ievt] += leaf[inode - 15];
+      }
+   }
+}
+
+void ReadBDTGForest_Part0( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part1( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part2( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part3( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part4( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part5( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part6( const double* iV, size_t nEvents, double* sum );
+void ReadBDTGForest_Part7( const double* iV, size_t nEvents, double* sum );
+
+class ReadBDTGForest : public IClassifierReader {
+
+ public:
+
+   // constructor
+   ReadBDTGForest( std::vector<std::string>& theInputVars )
+      : IClassifierReader(),
+        fClassName( "ReadBDTGForest" ),
+        fNvars( 13 ),
+        fIsNormalised( false )
+   {
+      // the training input variables
+      const char* inputVars[] = { "lep_pt", "met_phi", "mwt", "Whad_eta", "Wlep_m", "b_lep_pt", "b_had_pt", "dR_lb_had", "dR_lb2", "dR_Whad_blep", "mindR_jj", "mindR_lj", "Ht" };
+
+      // sanity checks
+      if (theInputVars.size() <= 0) {
+         std::cout << "Problem in class \"" << fClassName << "\": empty input vector" << std::endl;
+         fStatusIsClean = false;
+      }
+
+      if (theInputVars.size() != fNvars) {
+         std::cout << "Problem in class \"" << fClassName << "\": mismatch in number of input values: "
+                   << theInputVars.size() << " != " << fNvars << std::endl;
+         fStatusIsClean = false;
+      }
+
+      // validate input variables
+      for (size_t ivar = 0; ivar < theInputVars.size(); ivar++) {
+         if (theInputVars[ivar] != inputVars[ivar]) {
+            std::cout << "Problem in class \"" << fClassName << "\": mismatch in input variable names" << std::endl
+                      << " for variable [" << ivar << "]: " << theInputVars[ivar].c_str() << " != " << inputVars[ivar] << std::endl;
+            fStatusIsClean = false;
+         }
+      }
+
+      // initialize min and max vectors (for normalisation)
+      fVmin[0] = 20007.326171875;
+      fVmax[0] = 1097042.25;
+      fVmin[1] = -3.14142751693726;
+      fVmax[1] = 3.14110827445984;
+      fVmin[2] = 6.92663526535034;
+      fVmax[2] = 1539711.625;
+      fVmin[3] = -2.33010792732239;
+      fVmax[3] = 2.25264978408813;
+      fVmin[4] = 80394.3984375;
+      fVmax[4] = 1539711.625;
+      fVmin[5] = 25007.9375;
+      fVmax[5] = 1307815.875;
+      fVmin[6] = 25006.791015625;
+      fVmax[6] = 1480084;
+      fVmin[7] = 0.401370584964752;
+      fVmax[7] = 5.11403703689575;
+      fVmin[8] = 0.402186930179596;
+      fVmax[8] = 5.11403703689575;
+      fVmin[9] = 0.396414637565613;
+      fVmax[9] = 5.5275444984436;
+      fVmin[10] = 0.380293309688568;
+      fVmax[10] = 3.63540410995483;
+      fVmin[11] = 0.400214612483978;
+      fVmax[11] = 3.63768362998962;
+      fVmin[12] = 509029.90625;
+      fVmax[12] = 3296757.25;
+   }
+
+   // the classifier response
+   // "inputValues" is a vector of input values in the same order as the
+   // variables given to the constructor
+   double GetMvaValue( const std::vector<double>& inputValues ) const;
+
+   // the classifier response of a batch of events
+   // "rows" holds the input values of event i at rows[i*stride], in the same
+   // order as the variables given to the constructor
+   void GetMvaValues( const float* rows, size_t nEvents, size_t stride, double* out ) const;
+
+   // the steps of GetMvaValues, see IClassifierReader
+   void TransformInputs( const float* rows, size_t nEvents, size_t stride, double* iV ) const;
+   void GetMvaValuesTransformed( const double* iV, size_t nEvents, double* out ) const;
+   std::vector<double> GetTransformParameters() const;
+
+ private:
+
+   // sum the leaf values of all trees, in the original tree order
+   void SumForest( const double* iV, size_t nEvents, double* sum ) const;
+   double Response( double sum ) const { return 2.0/(1.0+exp(-2.0*sum))-1.0; }
+
+   const char* fClassName;
+   const size_t fNvars;
+
+   // normalisation of input variables
+   const bool fIsNormalised;
+   bool IsNormalised() const { return fIsNormalised; }
+   double fVmin[13];
+   double fVmax[13];
+   double NormVariable( double x, double xmin, double xmax ) const {
+      // normalise to output range: [-1, 1]
+      return 2*(x - xmin)/(xmax - xmin) - 1.0;
+   }
+};
+
+//_______________________________________________________________________
+inline void ReadBDTGForest::SumForest( const double* iV, size_t nEvents, double* sum ) const
+{
+   for (size_t ievt = 0; ievt < nEvents; ievt++) sum[ievt] = 0;
+   ReadBDTGForest_Part0( iV, nEvents, sum );
+   ReadBDTGForest_Part1( iV, nEvents, sum );
+   ReadBDTGForest_Part2( iV, nEvents, sum );
+   ReadBDTGForest_Part3( iV, nEvents, sum );
+   ReadBDTGForest_Part4( iV, nEvents, sum );
+   ReadBDTGForest_Part5( iV, nEvents, sum );
+   ReadBDTGForest_Part6( iV, nEvents, sum );
+   ReadBDTGForest_Part7( iV, nEvents, sum );
+}
+
+//_______________________________________________________________________
+inline double ReadBDTGForest::GetMvaValue( const std::vector<double>& inputValues ) const
+{
+   // classifier response, sanity check first
+   if (!IsStatusClean()) {
+      std::cout << "Problem in class \"" << fClassName << "\": cannot return classifier response"
+                << " because status is dirty" << std::endl;
+      return 0;
+   }
+
+   double iV[13];
+   for (int ivar = 0; ivar < 13; ivar++) {
+      iV[ivar] = IsNormalised() ? NormVariable( inputValues[ivar], fVmin[ivar], fVmax[ivar] ) : inputValues[ivar];
+   }
+   double sum;
+   SumForest( iV, 1, &sum );
+   return Response( sum );
+}
+
+//_______________________________________________________________________
+inline void ReadBDTGForest::GetMvaValues( const float* rows, size_t nEvents, size_t stride, double* out ) const
+{
+   // classifier response of a batch of events, sanity check once for the batch
+   if (!IsStatusClean()) {
+      std::cout << "Problem in class \"" << fClassName << "\": cannot return classifier response"
+                << " because status is dirty" << std::endl;
+      for (size_t ievt = 0; ievt < nEvents; ievt++) out[ievt] = 0;
+      return;
+   }
+
+   // events are transformed and scored in blocks
+   const size_t nBlock = 64;
+   double iV[nBlock*13];
+   for (size_t first = 0; first < nEvents; first += nBlock) {
+      size_t n = nEvents - first < nBlock ? nEvents - first : nBlock;
+      TransformInputs( rows + first*stride, n, stride, iV );
+      GetMvaValuesTransformed( iV, n, out + first );
+   }
+}
+
+//_______________________________________________________________________
+inline void ReadBDTGForest::TransformInputs( const float* rows, size_t nEvents, size_t stride, double* iV ) const
+{
+   // normalisation of the input variables
+   for (size_t ievt = 0; ievt < nEvents; ievt++) {
+      const float* row = rows + ievt*stride;
+      double* x = iV + ievt*13;
+      for (int ivar = 0; ivar < 13; ivar++) {
+         x[ivar] = IsNormalised() ? NormVariable( row[ivar], fVmin[ivar], fVmax[ivar] ) : row[ivar];
+      }
+   }
+}
+
+//_______________________________________________________________________
+inline std::vector<double> ReadBDTGForest::GetTransformParameters() const
+{
+   // normalisation ranges, if the input variables are normalised
+   std::vector<double> par( 1, IsNormalised() );
+   if (IsNormalised()) {
+      par.insert( par.end(), fVmin, fVmin + 13 );
+      par.insert( par.end(), fVmax, fVmax + 13 );
+   }
+   return par;
+}
+
+//_______________________________________________________________________
+inline void ReadBDTGForest::GetMvaValuesTransformed( const double* iV, size_t nEvents, double* out ) const
+{
+   // events are scored in blocks, each part of the forest is walked once per block
+   const size_t nBlock = 64;
+   double sum[nBlock];
+   for (size_t first = 0; first < nEvents; first += nBlock) {
+      size_t n = nEvents - first < nBlock ? nEvents - first : nBlock;
+      SumForest( iV + first*13, n, sum );
+      for (size_t ievt = 0; ievt < n; ievt++) out[first + ievt] = Response( sum[ievt] );
+   }
+}
+
+#endif
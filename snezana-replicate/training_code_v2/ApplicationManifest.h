@@ -0,0 +1,172 @@
+// ApplicationManifest: applies a booked MVA to many input files in one process
+//
+// The manifest lists one input file and its output file per line,
+//
+//    <input file> <output file>
+//
+// with empty lines and lines starting with '#' ignored. The files are applied by
+// forked copies of the driver, up to nWorkers at a time and one file each: the
+// MVA is booked once, before the workers are started, and every worker inherits
+// the booked reader instead of parsing the weight file again (ROOT 5 I/O and TMVA
+// are not thread safe). The largest inputs are started first, so that a big file
+// does not finish alone at the end, and the directory of an output file is
+// created if needed. A file that fails does not stop the others.
+//
+//    ApplicationManifest manifest( nworkers );
+//    if (!manifest.Read( "manifest.txt" )) return 1;
+//    manifest.Run( application );             // calls application.Apply( input, output )
+
+#ifndef ApplicationManifest__def
+#define ApplicationManifest__def
+
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "TString.h"
+#include "TSystem.h"
+
+// what is done with one file of the manifest, in a worker
+class FileApplication {
+
+ public:
+
+   virtual ~FileApplication() {}
+
+   // read the events of "input" and write their scores to "output"
+   virtual bool Apply( const TString& input, const TString& output ) = 0;
+};
+
+class ApplicationManifest {
+
+ public:
+
+   // nWorkers 0 is one worker per online processor
+   ApplicationManifest( int nWorkers = 0 )
+      : fNWorkers( nWorkers > 0 ? nWorkers : int(sysconf( _SC_NPROCESSORS_ONLN )) ) {}
+
+   // add the files listed in "path"; false if it cannot be read or a line is malformed
+   bool Read( const TString& path );
+
+   void AddFile( const TString& input, const TString& output );
+
+   int GetNFiles() const { return fInputs.size(); }
+
+   // apply to all files; false if any of them failed
+   bool Run( FileApplication& application ) const;
+
+ private:
+
+   bool RunFile( FileApplication& application, size_t ifile ) const;
+
+   int                  fNWorkers;
+   std::vector<TString> fInputs;
+   std::vector<TString> fOutputs;
+};
+
+//_______________________________________________________________________
+inline bool ApplicationManifest::Read( const TString& path )
+{
+   std::ifstream in( path.Data() );
+   if (!in) {
+      std::cout << "Problem in class \"ApplicationManifest\": cannot read " << path << std::endl;
+      return false;
+   }
+   std::string line;
+   for (int iline = 1; std::getline( in, line ); iline++) {
+      std::istringstream words( line );
+      std::string input, output, rest;
+      if (!(words >> input) || input[0] == '#') continue;
+      if (!(words >> output) || (words >> rest)) {
+         std::cout << "Problem in class \"ApplicationManifest\": line " << iline << " of " << path
+                   << " is not \"<input file> <output file>\"" << std::endl;
+         return false;
+      }
+      AddFile( input.c_str(), output.c_str() );
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline void ApplicationManifest::AddFile( const TString& input, const TString& output )
+{
+   fInputs.push_back( input );
+   fOutputs.push_back( output );
+}
+
+//_______________________________________________________________________
+inline bool ApplicationManifest::Run( FileApplication& application ) const
+{
+   // largest inputs first; missing ones are left for their worker to report
+   std::vector<std::pair<off_t, size_t> > order;
+   for (size_t ifile = 0; ifile < fInputs.size(); ifile++) {
+      struct stat info;
+      off_t size = stat( fInputs[ifile], &info ) == 0 ? info.st_size : 0;
+      order.push_back( std::make_pair( -size, ifile ) );
+   }
+   std::sort( order.begin(), order.end() );
+
+   // buffered output would otherwise be written by every worker as well
+   std::cout.flush();
+   std::cerr.flush();
+   fflush( 0 );
+
+   bool ok = true, started = true;
+   size_t next = 0;
+   std::map<pid_t, size_t> running;
+   while ((started && next < order.size()) || !running.empty()) {
+      if (started && next < order.size() && (int)running.size() < fNWorkers) {
+         size_t ifile = order[next].second;
+         pid_t pid = fork();
+         if (pid == 0) _exit( RunFile( application, ifile ) ? 0 : 1 );
+         if (pid < 0) {
+            std::cout << "Problem in class \"ApplicationManifest\": cannot start worker for " << fInputs[ifile] << std::endl;
+            ok = started = false;
+            continue;
+         }
+         running[pid] = ifile;
+         next++;
+         continue;
+      }
+
+      int status;
+      pid_t pid = waitpid( -1, &status, 0 );
+      if (pid < 0) {
+         if (errno == EINTR) continue;
+         break;
+      }
+      std::map<pid_t, size_t>::iterator it = running.find( pid );
+      if (it == running.end()) continue;
+      if (!WIFEXITED( status ) || WEXITSTATUS( status ) != 0) {
+         std::cout << "Problem in class \"ApplicationManifest\": " << fInputs[it->second] << " failed" << std::endl;
+         ok = false;
+      }
+      running.erase( it );
+   }
+   return ok;
+}
+
+//_______________________________________________________________________
+inline bool ApplicationManifest::RunFile( FileApplication& application, size_t ifile ) const
+{
+   std::string output( fOutputs[ifile].Data() );
+   size_t slash = output.find_last_of( '/' );
+   if (slash != std::string::npos && slash > 0) gSystem->mkdir( output.substr( 0, slash ).c_str(), kTRUE );
+
+   bool ok = application.Apply( fInputs[ifile], fOutputs[ifile] );
+   std::cout.flush();
+   std::cerr.flush();
+   return ok;
+}
+
+#endif
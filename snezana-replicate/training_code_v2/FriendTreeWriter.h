@@ -0,0 +1,271 @@
+// FriendTreeWriter: writes the MVA scores of a file as a friend tree, in the background
+//
+// The output file gets the tree "MVA" with the branches runNumber, eventNumber and
+// one float per score, one entry per entry of the input tree, so that it is read
+// as a friend of that tree:
+//
+//    TTree* mini = (TTree*)input->Get( "mini" );
+//    mini->AddFriend( "MVA", "scores.root" );
+//    mini->Draw( "MVA.MVA", "MVA.MVA > 0.9965" );
+//
+// The tree is filled, compressed and written by a forked writer process (ROOT 5 I/O
+// is not thread safe), which receives the scores in batches of batchSize events
+// through a pipe: the scoring goes on while the previous batches are compressed,
+// and blocks in Fill only when the pipe, a queue of a few batches, is full.
+//
+// The writer writes to <path>.part and renames it to the output only once Close
+// succeeds. A writer that is not closed, because the file failed, is aborted by
+// Abort or the destructor: nothing is left at the output path, not even the output
+// of an earlier run, so a failed file cannot be taken for a scored one.
+//
+//    FriendTreeWriter writer( "scores.root", scoreNames );
+//    if (!writer.Open()) return false;
+//    for (...) writer.Fill( runNumber, eventNumber, scores );
+//    if (!writer.Close()) return false;
+
+#ifndef FriendTreeWriter__def
+#define FriendTreeWriter__def
+
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TString.h"
+
+class FriendTreeWriter {
+
+ public:
+
+   FriendTreeWriter( const TString& path, const std::vector<TString>& scoreNames, int batchSize = 1024 )
+      : fPath( path ), fScoreNames( scoreNames ), fBatchSize( batchSize > 0 ? batchSize : 1 ),
+        fPid( -1 ), fFd( -1 ), fOk( false ) {}
+
+   ~FriendTreeWriter() { if (fPid > 0) Abort(); }
+
+   // start the writer; false if it cannot be started
+   bool Open();
+
+   // add the next entry; "scores" holds one value per score name
+   void Fill( Int_t runNumber, Int_t eventNumber, const Float_t* scores );
+
+   // send the last batch and wait for the file to be written; false if anything failed
+   bool Close();
+
+   // stop the writer and remove the output
+   void Abort();
+
+ private:
+
+   bool Send();
+   bool RunWriter( int fd ) const;
+
+   static bool WriteAll( int fd, const void* buffer, size_t size );
+   static bool ReadAll( int fd, void* buffer, size_t size );
+
+   TString              fPath;
+   std::vector<TString> fScoreNames;
+   int                  fBatchSize;
+   pid_t                fPid;
+   int                  fFd;
+   bool                 fOk;
+   std::vector<Int_t>   fRunNumbers;
+   std::vector<Int_t>   fEventNumbers;
+   std::vector<Float_t> fScores;
+};
+
+//_______________________________________________________________________
+inline bool FriendTreeWriter::Open()
+{
+   fRunNumbers.clear();
+   fEventNumbers.clear();
+   fScores.clear();
+
+   // buffered output would otherwise be written by the writer as well
+   std::cout.flush();
+   std::cerr.flush();
+   fflush( 0 );
+
+   int fd[2];
+   if (pipe( fd ) != 0) {
+      std::cout << "Problem in class \"FriendTreeWriter\": cannot start the writer of " << fPath << std::endl;
+      return false;
+   }
+   fPid = fork();
+   if (fPid < 0) {
+      close( fd[0] );
+      close( fd[1] );
+      std::cout << "Problem in class \"FriendTreeWriter\": cannot start the writer of " << fPath << std::endl;
+      return false;
+   }
+   if (fPid == 0) {
+      close( fd[1] );
+      bool ok = RunWriter( fd[0] );
+      close( fd[0] );
+      _exit( ok ? 0 : 1 );
+   }
+   close( fd[0] );
+   // a writer that died is reported by Close, not by a SIGPIPE in Fill
+   signal( SIGPIPE, SIG_IGN );
+   fFd = fd[1];
+   fOk = true;
+   return true;
+}
+
+//_______________________________________________________________________
+inline void FriendTreeWriter::Fill( Int_t runNumber, Int_t eventNumber, const Float_t* scores )
+{
+   fRunNumbers.push_back( runNumber );
+   fEventNumbers.push_back( eventNumber );
+   fScores.insert( fScores.end(), scores, scores + fScoreNames.size() );
+   if ((int)fRunNumbers.size() >= fBatchSize) Send();
+}
+
+//_______________________________________________________________________
+inline bool FriendTreeWriter::Close()
+{
+   if (fPid <= 0) return false;
+   if (!fRunNumbers.empty()) Send();
+   close( fFd );
+   fFd = -1;
+
+   int status;
+   pid_t pid;
+   do pid = waitpid( fPid, &status, 0 );
+   while (pid < 0 && errno == EINTR);
+   fPid = -1;
+   if (pid < 0 || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0) {
+      std::cout << "Problem in class \"FriendTreeWriter\": the writer of " << fPath << " failed" << std::endl;
+      fOk = false;
+   }
+   // a batch that was not sent may still have left a complete, shorter tree
+   if (!fOk) remove( fPath );
+   return fOk;
+}
+
+//_______________________________________________________________________
+inline void FriendTreeWriter::Abort()
+{
+   if (fPid > 0) {
+      close( fFd );
+      fFd = -1;
+      kill( fPid, SIGKILL );
+      pid_t pid;
+      do pid = waitpid( fPid, 0, 0 );
+      while (pid < 0 && errno == EINTR);
+      fPid = -1;
+   }
+   fOk = false;
+   remove( fPath + ".part" );
+   remove( fPath );
+}
+
+//_______________________________________________________________________
+inline bool FriendTreeWriter::Send()
+{
+   Int_t n = fRunNumbers.size();
+   if (fOk) {
+      fOk = WriteAll( fFd, &n, sizeof(n) )
+         && WriteAll( fFd, &fRunNumbers[0], n*sizeof(Int_t) )
+         && WriteAll( fFd, &fEventNumbers[0], n*sizeof(Int_t) )
+         && (fScores.empty() || WriteAll( fFd, &fScores[0], fScores.size()*sizeof(Float_t) ));
+   }
+   fRunNumbers.clear();
+   fEventNumbers.clear();
+   fScores.clear();
+   return fOk;
+}
+
+//_______________________________________________________________________
+inline bool FriendTreeWriter::RunWriter( int fd ) const
+{
+   TString temporary = fPath + ".part";
+   TFile* target = TFile::Open( temporary, "RECREATE" );
+   if (!target || target->IsZombie()) {
+      std::cout << "Problem in class \"FriendTreeWriter\": cannot create " << temporary << std::endl;
+      delete target;
+      remove( temporary );
+      return false;
+   }
+   target->cd();
+   TTree* tree = new TTree( "MVA", "MVA scores, friend of the input tree" );
+   Int_t runNumber, eventNumber;
+   std::vector<Float_t> scores( fScoreNames.size() );
+   tree->Branch( "runNumber", &runNumber, "runNumber/I" );
+   tree->Branch( "eventNumber", &eventNumber, "eventNumber/I" );
+   for (size_t iscore = 0; iscore < fScoreNames.size(); iscore++) {
+      tree->Branch( fScoreNames[iscore], &scores[iscore], fScoreNames[iscore] + "/F" );
+   }
+
+   std::vector<Int_t>   runNumbers, eventNumbers;
+   std::vector<Float_t> batch;
+   bool ok = true;
+   Int_t n;
+   while (ReadAll( fd, &n, sizeof(n) )) {
+      runNumbers.resize( n );
+      eventNumbers.resize( n );
+      batch.resize( n*scores.size() );
+      ok = n > 0
+         && ReadAll( fd, &runNumbers[0], n*sizeof(Int_t) )
+         && ReadAll( fd, &eventNumbers[0], n*sizeof(Int_t) )
+         && (batch.empty() || ReadAll( fd, &batch[0], batch.size()*sizeof(Float_t) ));
+      if (!ok) {
+         std::cout << "Problem in class \"FriendTreeWriter\": truncated batch for " << fPath << std::endl;
+         break;
+      }
+      for (Int_t ievt = 0; ievt < n; ievt++) {
+         runNumber   = runNumbers[ievt];
+         eventNumber = eventNumbers[ievt];
+         for (size_t iscore = 0; iscore < scores.size(); iscore++) scores[iscore] = batch[ievt*scores.size() + iscore];
+         tree->Fill();
+      }
+   }
+
+   target->cd();
+   tree->Write();
+   target->Close();
+   delete target;
+   if (ok && rename( temporary, fPath ) != 0) {
+      std::cout << "Problem in class \"FriendTreeWriter\": cannot rename " << temporary << " to " << fPath << std::endl;
+      ok = false;
+   }
+   if (!ok) remove( temporary );
+   std::cout.flush();
+   return ok;
+}
+
+//_______________________________________________________________________
+inline bool FriendTreeWriter::WriteAll( int fd, const void* buffer, size_t size )
+{
+   const char* p = (const char*)buffer;
+   while (size > 0) {
+      ssize_t n = write( fd, p, size );
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= n;
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool FriendTreeWriter::ReadAll( int fd, void* buffer, size_t size )
+{
+   char* p = (char*)buffer;
+   while (size > 0) {
+      ssize_t n = read( fd, p, size );
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= n;
+   }
+   return true;
+}
+
+#endif
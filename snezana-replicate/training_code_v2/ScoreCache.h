@@ -0,0 +1,222 @@
+// ScoreCache: persistent MVA scores, so that an event scored before is not scored again
+//
+// The scores are stored per weight file and input file, in
+//
+//    <dir>/<weights key>/<input key>.scores
+//
+// where the weights key is a 64 bit hash of the content of the weight file, and the
+// input key one of the path, size and modification time of the input file: a new
+// training or a regenerated input starts an empty store. Inside, an event is
+// identified by (runNumber, eventNumber); the records are kept sorted by it, and
+// an id that appears more than once in an input is marked as ambiguous and always
+// scored again, which needs all events of the input to be scored in the pass
+// that is saved. Save writes the store to a temporary file which is renamed over
+// the old one, so that a killed job or two workers on the same input never leave
+// a partial store behind.
+//
+//    ScoreCache cache( "score_cache", weight_file );
+//    cache.Load( input_file );
+//    for (...) {
+//       if (!cache.Find( runNumber, eventNumber, MVA )) {
+//          MVA = reader->EvaluateMVA( "MLP method" );
+//          cache.Add( runNumber, eventNumber, MVA );
+//       }
+//    }
+//    cache.Save();
+
+#ifndef ScoreCache__def
+#define ScoreCache__def
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "TString.h"
+#include "TSystem.h"
+
+class ScoreCache {
+
+ public:
+
+   // the weight file is hashed once, here
+   ScoreCache( const TString& dir, const TString& weightFile );
+
+   // false if the weight file could not be read: nothing is then cached
+   bool IsValid() const { return !fWeightsKey.empty(); }
+
+   // read the scores of "input"; false if there were none
+   bool Load( const TString& input );
+
+   bool Find( Int_t runNumber, Int_t eventNumber, Float_t& score ) const;
+
+   // a score to store with the next Save
+   void Add( Int_t runNumber, Int_t eventNumber, Float_t score );
+
+   // write the store of the loaded input, if scores were added
+   bool Save();
+
+   size_t GetNStored() const { return fRecords.size(); }
+   size_t GetNAdded() const  { return fAdded.size(); }
+
+   // 64 bit FNV-1a of "n" bytes, continued from "hash"
+   static unsigned long long Hash( const char* bytes, size_t n, unsigned long long hash = 14695981039346656037ULL );
+
+ private:
+
+   struct Record {
+      Int_t   runNumber;
+      Int_t   eventNumber;
+      Float_t score;
+      bool operator<( const Record& other ) const {
+         return runNumber < other.runNumber || (runNumber == other.runNumber && eventNumber < other.eventNumber);
+      }
+   };
+
+   static std::string MakeKey( unsigned long long hash );
+
+   std::string         fDir;
+   std::string         fWeightsKey;
+   std::string         fPath;      // of the store of the loaded input
+   std::vector<Record> fRecords;   // sorted by id
+   std::vector<Record> fAdded;
+};
+
+//_______________________________________________________________________
+inline ScoreCache::ScoreCache( const TString& dir, const TString& weightFile )
+   : fDir( dir.Data() )
+{
+   std::ifstream in( weightFile.Data(), std::ios::binary );
+   std::stringstream buffer;
+   if (in) buffer << in.rdbuf();
+   std::string text = buffer.str();
+   if (!in || text.empty()) {
+      std::cout << "Problem in class \"ScoreCache\": cannot read " << weightFile << std::endl;
+      return;
+   }
+   fWeightsKey = MakeKey( Hash( text.data(), text.size() ) );
+}
+
+//_______________________________________________________________________
+inline unsigned long long ScoreCache::Hash( const char* bytes, size_t n, unsigned long long hash )
+{
+   for (size_t i = 0; i < n; i++) {
+      hash ^= (unsigned char)bytes[i];
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+//_______________________________________________________________________
+inline std::string ScoreCache::MakeKey( unsigned long long hash )
+{
+   char key[17];
+   snprintf( key, sizeof(key), "%016llx", hash );
+   return key;
+}
+
+//_______________________________________________________________________
+inline bool ScoreCache::Load( const TString& input )
+{
+   fPath.clear();
+   fRecords.clear();
+   fAdded.clear();
+   if (!IsValid()) return false;
+
+   struct stat info;
+   if (stat( input, &info ) != 0) return false;
+   std::ostringstream description;
+   description << input << "\n" << info.st_size << "\n" << info.st_mtime;
+   std::string text = description.str();
+   fPath = fDir + "/" + fWeightsKey + "/" + MakeKey( Hash( text.data(), text.size() ) ) + ".scores";
+
+   std::ifstream in( fPath.c_str(), std::ios::binary );
+   if (!in) return false;
+   in.seekg( 0, std::ios::end );
+   std::streamoff size = in.tellg();
+   in.seekg( 0 );
+   if (size < 0 || size % sizeof(Record) != 0) {
+      std::cout << "Problem in class \"ScoreCache\": " << fPath << " is corrupt, it is ignored" << std::endl;
+      return false;
+   }
+   fRecords.resize( size/sizeof(Record) );
+   if (!fRecords.empty() && !in.read( (char*)&fRecords[0], size )) {
+      std::cout << "Problem in class \"ScoreCache\": cannot read " << fPath << std::endl;
+      fRecords.clear();
+      return false;
+   }
+   return true;
+}
+
+//_______________________________________________________________________
+inline bool ScoreCache::Find( Int_t runNumber, Int_t eventNumber, Float_t& score ) const
+{
+   Record key;
+   key.runNumber   = runNumber;
+   key.eventNumber = eventNumber;
+   std::vector<Record>::const_iterator it = std::lower_bound( fRecords.begin(), fRecords.end(), key );
+   if (it == fRecords.end() || it->runNumber != runNumber || it->eventNumber != eventNumber) return false;
+   // ambiguous ids are stored with a NaN score
+   if (it->score != it->score) return false;
+   score = it->score;
+   return true;
+}
+
+//_______________________________________________________________________
+inline void ScoreCache::Add( Int_t runNumber, Int_t eventNumber, Float_t score )
+{
+   Record record;
+   record.runNumber   = runNumber;
+   record.eventNumber = eventNumber;
+   record.score       = score;
+   fAdded.push_back( record );
+}
+
+//_______________________________________________________________________
+inline bool ScoreCache::Save()
+{
+   if (fPath.empty() || fAdded.empty()) return true;
+
+   // the new scores of ids that are already stored are those of ambiguous ids
+   std::vector<Record> records;
+   records.reserve( fRecords.size() + fAdded.size() );
+   records.insert( records.end(), fRecords.begin(), fRecords.end() );
+   records.insert( records.end(), fAdded.begin(), fAdded.end() );
+   std::stable_sort( records.begin(), records.end() );
+   size_t nrecords = 0;
+   for (size_t irecord = 0; irecord < records.size(); irecord++) {
+      if (nrecords > 0 && !(records[nrecords - 1] < records[irecord])) {
+         records[nrecords - 1].score = std::numeric_limits<Float_t>::quiet_NaN();
+         continue;
+      }
+      records[nrecords++] = records[irecord];
+   }
+   records.resize( nrecords );
+
+   std::string dir = fPath.substr( 0, fPath.find_last_of( '/' ) );
+   gSystem->mkdir( dir.c_str(), kTRUE );
+   std::ostringstream temporary;
+   temporary << fPath << ".tmp" << getpid();
+   std::ofstream out( temporary.str().c_str(), std::ios::binary );
+   bool ok = out && out.write( (const char*)&records[0], records.size()*sizeof(Record) );
+   out.close();
+   ok = ok && !out.fail() && rename( temporary.str().c_str(), fPath.c_str() ) == 0;
+   if (!ok) {
+      std::cout << "Problem in class \"ScoreCache\": cannot write " << fPath << std::endl;
+      unlink( temporary.str().c_str() );
+      return false;
+   }
+   fRecords.swap( records );
+   fAdded.clear();
+   return true;
+}
+
+#endif
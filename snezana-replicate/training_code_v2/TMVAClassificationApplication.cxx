@@ -13,9 +13,11 @@
 #include <map>
 #include <string>
 #include <math.h>
+#include <algorithm>
 
 #include "TFile.h"
 #include "TTree.h"
+#include "TBranch.h"
 #include "TString.h"
 #include "TSystem.h"
 #include "TROOT.h"
@@ -26,54 +28,61 @@
 #include "TMVA/Tools.h"
 #include "TMVA/MethodCuts.h"
 
-using namespace std;
-
-int main( int argc, char** argv )
-{
-
-	std::map<std::string,int> nIdenticalResults;
+#include "ApplicationManifest.h"
+#include "FriendTreeWriter.h"
+#include "ScoreCache.h"
 
-	std::cout << std::endl;
-	std::cout << "==> Start TMVAClassificationApplication" << std::endl;
+using namespace std;
 
-	std::string input_file;
-	std::string output_file;
-	if(argc>1){
-		input_file = std::string(argv[1]);
-		output_file = std::string(argv[2]);
+// The MLP booked once in a reader, applied to the mini tree of one file at a time.
+// The output file is a friend tree of the mini tree (see FriendTreeWriter.h), with
+// runNumber, eventNumber and the MLP response MVA of every entry; the events with
+// analysis_channel 0 are not scored and have MVA -999, as have the entries after
+// the first nEvts, so that the friend tree stays aligned. With a ScoreCache, the scores
+// found in it are not computed again, and the variables of those events not read.
+class MLPApplication : public FileApplication {
+
+public:
+
+	MLPApplication(int nEvts) : nEvts(nEvts), cache(0) {
+		reader = new TMVA::Reader( "!Color:!Silent" );
+
+		// Create a set of variables and declare them to the reader
+		// - the variable names must corresponds in name and type to
+		// those given in the weight file(s) that you use
+		reader->AddVariable( "Ht", &Ht );
+		reader->AddVariable( "b_had_pt", &b_had_pt );
+		reader->AddVariable( "dR_lb_lep", &dR_lb_lep );
+		reader->AddVariable( "b_lep_pt", &b_lep_pt );
+		reader->AddVariable( "dR_Whad_bhad", &dR_Whad_bhad );
+		reader->AddVariable( "dR_lnu", &dR_lnu );
+		reader->AddVariable( "dR_Whad_blep", &dR_Whad_blep );
+		reader->AddVariable( "dR_lb_had", &dR_lb_had );
+
+		// Spectator variables declared in the training have to be added to the reader, too
+		reader->AddSpectator( "mc_weight := weight_1btin_70*weight_70/btweight_70", &mc_weight ); // SN hard code
+		reader->AddSpectator( "m_reco", &m_reco);
+		reader->AddSpectator( "runNumber", &runNumber);
+		reader->AddSpectator( "eventNumber", &eventNumber);
 	}
-	else{
-		input_file = "/mnt/xrootdb/alister/MVA_studies/samples/nominal_mu/tprime_650.root";
-		output_file = "/home/inutard/training_code_v2/TMVA_output/nominal_mu/tprime_650.root";
-	}
-
-	TString weight_file;
-	if(argc>3)
-		weight_file = std::string(argv[3]);
-	else
-		weight_file = "weights/TMVAClassification_MLP.weights.xml";
-
-	int nEvts = -1;
-	if(argc>4)
-		nEvts = atoi(argv[4]);
 
-	cout<<"Input file: "<<input_file<<endl;
-	cout<<"Output file: "<<output_file<<endl;
-	cout<<"MVA Weights file: "<<weight_file<<endl;
-	cout<<"Running over N events (-1 means all): "<<nEvts<<endl;
+	~MLPApplication() { delete reader; }
 
-	// --------------------------------------------------------------------------------------------------
-
-	// --- Create the Reader object
+	// --- Book the MVA methods
+	void Book(const TString& weight_file) {
+		reader->BookMVA( "MLP method", weight_file );
+	}
 
-	TMVA::Reader *reader = new TMVA::Reader( "!Color:!Silent" );
+	// the cache must outlive the application
+	void SetCache(ScoreCache* score_cache) { cache = score_cache; }
 
-	// Create a set of variables and declare them to the reader
-	// - the variable names must corresponds in name and type to
-	// those given in the weight file(s) that you use
+	bool Apply(const TString& input_file, const TString& output_file);
 
+private:
 
-	//Float_t jet_pt[50]; // AL: this was wrong: cannot initialise an array with a non-initialised number
+	TMVA::Reader *reader;
+	int nEvts;
+	ScoreCache *cache;
 
 	Float_t	Ht;
 	Float_t	b_lep_pt;
@@ -84,38 +93,26 @@ int main( int argc, char** argv )
 	Float_t	dR_lb_lep;
 	Float_t	dR_lb_had;
 
-	reader->AddVariable( "Ht", &Ht );
-	reader->AddVariable( "b_had_pt", &b_had_pt );
-	reader->AddVariable( "dR_lb_lep", &dR_lb_lep );
-	reader->AddVariable( "b_lep_pt", &b_lep_pt );
-	reader->AddVariable( "dR_Whad_bhad", &dR_Whad_bhad );
-	reader->AddVariable( "dR_lnu", &dR_lnu );
-	reader->AddVariable( "dR_Whad_blep", &dR_Whad_blep );
-	reader->AddVariable( "dR_lb_had", &dR_lb_had );
-
-	// Spectator variables declared in the training have to be added to the reader, too
 	Float_t mc_weight;
 	Float_t m_reco;
 	Int_t runNumber, eventNumber, analysis_channel;
-	reader->AddSpectator( "mc_weight := weight_1btin_70*weight_70/btweight_70", &mc_weight ); // SN hard code
-	reader->AddSpectator( "m_reco", &m_reco);
-	reader->AddSpectator( "runNumber", &runNumber);
-	reader->AddSpectator( "eventNumber", &eventNumber);
-
-	// --- Book the MVA methods
-	TString methodName = TString("MLP") + TString(" method");
-	reader->BookMVA( methodName, weight_file ); 
-
-
-	// Prepare input tree (this must be replaced by your data source)
-	// in this example, there is a toy tree with signal and one with background events
-	// we'll later on use only the "signal" events for the test in this example.
-	//
-	TFile* input = TFile::Open( (TString)input_file, "READ" ); // check if file in local directory exists
+	Float_t weight_70, btweight_70, weight_1btin_70;
+};
 
-	if (!input) {
-		std::cout << "ERROR: could not open data file" << std::endl;
-		exit(1);
+bool MLPApplication::Apply(const TString& input_file, const TString& output_file)
+{
+	// the writer is started first, so that it does not inherit the input file; when
+	// the file fails before Close, the writer is aborted and leaves no output
+	std::vector<TString> score_names(1, "MVA");
+	FriendTreeWriter writer(output_file, score_names);
+	if (!writer.Open()) return false;
+
+	TFile* input = TFile::Open( input_file, "READ" ); // check if file in local directory exists
+
+	if (!input || input->IsZombie()) {
+		std::cout << "ERROR: could not open data file " << input_file << std::endl;
+		delete input;
+		return false;
 	}
 	std::cout << "--- TMVAClassificationApp    : Using input file: " << input->GetName() << std::endl;
 
@@ -126,10 +123,14 @@ int main( int argc, char** argv )
 	// - you can use the same variables as above which is slightly faster,
 	//   but of course you can use different ones and copy the values inside the event loop
 	//
-	std::cout << "--- Select signal sample" << std::endl;
 	TTree* theTree = (TTree*)input->Get("mini");
+	if (!theTree) {
+		std::cout << "ERROR: no tree mini in " << input_file << std::endl;
+		input->Close();
+		delete input;
+		return false;
+	}
 
-	Float_t weight_70, btweight_70, weight_1btin_70;
 	theTree->SetBranchAddress( "Ht", &Ht );
 	theTree->SetBranchAddress( "b_lep_pt", &b_lep_pt );
 	theTree->SetBranchAddress( "b_had_pt", &b_had_pt );
@@ -138,89 +139,191 @@ int main( int argc, char** argv )
 	theTree->SetBranchAddress( "dR_Whad_bhad", &dR_Whad_bhad );
 	theTree->SetBranchAddress( "dR_lb_lep", &dR_lb_lep );
 	theTree->SetBranchAddress( "dR_lb_had", &dR_lb_had );   
+	theTree->SetBranchAddress( "runNumber", &runNumber );
+	theTree->SetBranchAddress( "eventNumber", &eventNumber );
 	theTree->SetBranchAddress( "analysis_channel", &analysis_channel);
 	theTree->SetBranchAddress( "weight_70", &weight_70);
 	theTree->SetBranchAddress( "btweight_70", &btweight_70);
 	theTree->SetBranchAddress( "weight_1btin_70", &weight_1btin_70);
-	// Efficiency calculator for cut method
-	//Int_t    nSelCutsGA = 0;
-	//Double_t effS       = 0.7;
 
-	std::vector<Float_t> vecVar(5); // vector for EvaluateMVA tests
+	// the branches are read one by one: the variables only for the events that are scored
+	const char* id_names[] = { "runNumber", "eventNumber", "analysis_channel", "weight_70", "btweight_70", "weight_1btin_70" };
+	const char* variable_names[] = { "Ht", "b_lep_pt", "b_had_pt", "dR_lnu", "dR_Whad_blep", "dR_Whad_bhad", "dR_lb_lep", "dR_lb_had" };
+	std::vector<TBranch*> id_branches, variable_branches;
+	for (int i = 0; i < 6; i++) id_branches.push_back( theTree->GetBranch(id_names[i]) );
+	for (int i = 0; i < 8; i++) variable_branches.push_back( theTree->GetBranch(variable_names[i]) );
+	if (std::count(id_branches.begin(), id_branches.end(), (TBranch*)0) > 0 ||
+			std::count(variable_branches.begin(), variable_branches.end(), (TBranch*)0) > 0) {
+		std::cout << "ERROR: missing branches in " << input_file << std::endl;
+		input->Close();
+		delete input;
+		return false;
+	}
+
+	if (cache && cache->Load(input_file)) {
+		std::cout << "--- " << cache->GetNStored() << " scores of " << input_file << " found in the cache" << std::endl;
+	}
 
 	std::cout << "--- Processing: " << theTree->GetEntries() << " events" << std::endl;
 	TStopwatch sw;
 	sw.Start();
 
-
-	//TString target_name = output_file;
-	//TFile *target = 0;
-	//target = TFile::Open( target_name,"RECREATE" );
-	TTree *tree = theTree->CloneTree(0);
-	//tree->SetDirectory(target);
-	//target->cd();
-	Float_t MVA;
-	tree->Branch("MVA", &MVA, "MVA/F");
-
-
-	Int_t nEvent = theTree->GetEntries();
-	if(nEvts != -1) nEvent = nEvts;
+	// the entries after nEvent are written to the friend tree, unscored
+	Long64_t nEntries = theTree->GetEntries();
+	Long64_t nEvent = nEntries;
+	if(nEvts != -1 && nEvts < nEvent) nEvent = nEvts;
 
 	int cnt = 0;
 	double tot = 0;
+	int nScored = 0, nCached = 0;
 
-	//UInt_t nbin = 100;
-	//TH1F *histMLP(0);
-	//histMLP = new TH1F( "MVA_MLP",           "MVA_MLP",           nbin, -1.25, 1.5 );
-	for (Long64_t ievt=0; ievt<nEvent; ievt++) {
+	for (Long64_t ievt=0; ievt<nEntries; ievt++) {
 
-
-		if (ievt%10000 == 0) {
+		if (ievt%10000 == 0 && ievt < nEvent) {
 			std::cout << "--- ... Processing event: " << ievt << std::endl;
-			std::cout << tot << endl; 
 		}
 
-		theTree->GetEntry(ievt);
-		if (analysis_channel == 0) continue;
-
-		//theTree->Show(ievt);
-
-		// --- Return the MVA outputs and fill into histograms
-		MVA = reader->EvaluateMVA( "MLP method" );
+		Long64_t entry = theTree->LoadTree(ievt);
+		for (size_t ib = 0; ib < id_branches.size(); ib++) id_branches[ib]->GetEntry(entry);
+		Float_t MVA = -999;
+		if (ievt >= nEvent) {
+			writer.Fill(runNumber, eventNumber, &MVA);
+			continue;
+		}
+		if (analysis_channel != 0) {
+			mc_weight = weight_1btin_70*weight_70/btweight_70;
+
+			if (cache && cache->Find(runNumber, eventNumber, MVA)) nCached++;
+			else {
+				for (size_t ib = 0; ib < variable_branches.size(); ib++) variable_branches[ib]->GetEntry(entry);
+
+				// --- Return the MVA outputs
+				MVA = reader->EvaluateMVA( "MLP method" );
+				if (cache) cache->Add(runNumber, eventNumber, MVA);
+				nScored++;
+			}
+		}
+		writer.Fill(runNumber, eventNumber, &MVA);
 
-		if (MVA <= 0.9965) continue;
+		if (analysis_channel == 0 || MVA <= 0.9965) continue;
 
 		cnt++;
-		//histMLP->Fill(MVA);
-
-		tot += weight_1btin_70*weight_70/btweight_70;//MVA; //mc_weight;
-		/*
-		   if (tot > 10.3) {
-		   cout << cnt << " " << tot << endl;
-		   break;
-		   }
-		 */
-		/*
-		   if (cnt >= 4737) {
-		   cout << tot << endl;    
-		   break; 
-		   }
-		 */
-		// tree->Fill();
+		tot += mc_weight;
 	}
 
-	cout << "Final count: " << tot << endl;
+	cout << "Final count: " << cnt << ", weighted: " << tot << endl;
+	cout << "Scored events: " << nScored << ", from the cache: " << nCached << endl;
 	// Get elapsed time
 	sw.Stop();
 	std::cout << "--- End of event loop: "; sw.Print();
 
-	std::cout << "--- Created root file containing the MVA output histograms" << std::endl;
+	// only a pass over all events finds the ids that are not unique in the input
+	if (cache && nEvent == nEntries) cache->Save();
+
+	input->Close();
+	delete input;
+
+	if (!writer.Close()) return false;
+	std::cout << "--- Created root file " << output_file << " containing the MVA friend tree" << std::endl;
+	return true;
+}
+
+// Either one file,
+//
+//    TMVAClassificationApplication [-c <cache dir>] <input file> <output file> [<weight file>] [<n events>]
+//
+// or all the files of a manifest (see ApplicationManifest.h) with the MVA booked once,
+// on nWorkers processes (0: one per processor)
+//
+//    TMVAClassificationApplication [-c <cache dir>] -m <manifest> [<weight file>] [<n events>] [<n workers>]
+//
+// With -c, the scores are kept in the cache directory, see ScoreCache.h
+int main( int argc, char** argv )
+{
+	std::cout << std::endl;
+	std::cout << "==> Start TMVAClassificationApplication" << std::endl;
+
+	std::string manifest_file;
+	std::string cache_dir;
+	int iarg = 1;
+	while (iarg + 1 < argc && (std::string(argv[iarg]) == "-m" || std::string(argv[iarg]) == "-c")) {
+		if (std::string(argv[iarg]) == "-m") manifest_file = argv[iarg + 1];
+		else cache_dir = argv[iarg + 1];
+		iarg += 2;
+	}
+	bool use_manifest = !manifest_file.empty();
+
+	std::string input_file;
+	std::string output_file;
+	if(!use_manifest && argc>iarg+1){
+		input_file = std::string(argv[iarg]);
+		output_file = std::string(argv[iarg+1]);
+		iarg += 2;
+	}
+	else if(!use_manifest){
+		input_file = "/mnt/xrootdb/alister/MVA_studies/samples/nominal_mu/tprime_650.root";
+		output_file = "/home/inutard/training_code_v2/TMVA_output/nominal_mu/tprime_650.root";
+		iarg = argc;
+	}
+
+	TString weight_file;
+	if(argc>iarg)
+		weight_file = std::string(argv[iarg]);
+	else
+		weight_file = "weights/TMVAClassification_MLP.weights.xml";
+
+	int nEvts = -1;
+	if(argc>iarg+1)
+		nEvts = atoi(argv[iarg+1]);
+
+	int nWorkers = 0;
+	if(use_manifest && argc>iarg+2)
+		nWorkers = atoi(argv[iarg+2]);
+
+	if (use_manifest) cout<<"Manifest: "<<manifest_file<<endl;
+	else {
+		cout<<"Input file: "<<input_file<<endl;
+		cout<<"Output file: "<<output_file<<endl;
+	}
+	cout<<"MVA Weights file: "<<weight_file<<endl;
+	cout<<"Running over N events (-1 means all): "<<nEvts<<endl;
+	if (!cache_dir.empty()) cout<<"Score cache: "<<cache_dir<<endl;
+
+	// --------------------------------------------------------------------------------------------------
 
-	//histMLP->Write();
-	//target->Write();
-	//target->Close();
+	// --- Create the Reader object and book the MLP, once for all files
+	MLPApplication application(nEvts);
+	application.Book(weight_file);
+
+	// a cache asked for that cannot be keyed on the weights is an error, not a full rescoring
+	ScoreCache *cache = 0;
+	if (!cache_dir.empty()) {
+		cache = new ScoreCache(cache_dir, weight_file);
+		if (!cache->IsValid()) {
+			std::cout << "ERROR: no score cache without the weight file " << weight_file << std::endl;
+			delete cache;
+			return 1;
+		}
+		application.SetCache(cache);
+	}
+
+	bool ok;
+	if (use_manifest) {
+		ApplicationManifest manifest(nWorkers);
+		if (!manifest.Read(manifest_file)) return 1;
+		std::cout << "--- Applying to " << manifest.GetNFiles() << " files" << std::endl;
+		TStopwatch sw;
+		sw.Start();
+		ok = manifest.Run(application);
+		sw.Stop();
+		std::cout << "--- End of manifest: "; sw.Print();
+	}
+	else {
+		ok = application.Apply(input_file, output_file);
+	}
 
-	delete reader;
+	delete cache;
 
 	std::cout << "==> TMVAClassificationApplication is done!" << std::endl << std::endl;
+	return ok ? 0 : 1;
 }
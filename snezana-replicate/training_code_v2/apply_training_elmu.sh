@@ -9,7 +9,7 @@ analysis_channel=combined
 btconf=_1btin
 
 ################## Running TMVAClassificationApplication
-weights_file=weights/Training_${lepton}_${training_name} #/TMVAClassification_MLP.weights.xml
+weights_file=weights/Training_${lepton}_${training_name}/TMVAClassification_${method1}.weights.xml
 
 #nevts=-1 
 ###nevts=10000
@@ -90,9 +90,14 @@ for channel in mu
 done
 
 #######################################################
-# Applying NN
+# Applying NN: all files are listed in a manifest, and applied by one
+# TMVAClassificationApplication that books the MVA once (see ApplicationManifest.h)
 
 cd ${home}
+manifest=${home}/manifest_${lepton}_${training_name}.txt
+nworkers=0 # 0: one worker per processor
+score_cache=${home}/score_cache # scores kept between runs, see ScoreCache.h
+rm -f ${manifest}
 for channel in el mu
   do
   
@@ -100,10 +105,7 @@ for channel in el mu
     do
     for file in tprime_500_1M.root data.root qcd.root
       do
-      echo 'running over ' ${input_path}/${channel}/${syst}/${file}
-      ./TMVAClassificationApplication ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} ${weights_file} ${nevts}
-      mv TMVApp.root ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/$${syst}/{file}
-      echo 'moving output to ' ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file}
+      echo ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} >> ${manifest}
     done
   done
   
@@ -111,10 +113,7 @@ for channel in el mu
     do
     for file in ttbar.root wjets.root zjets.root diboson.root singletop.root tprime_500.root tprime_550.root tprime_600.root tprime_650.root tprime_700.root tprime_750.root 
       do
-      echo 'running over ' ${input_path}/${channel}/${syst}/${file}
-      ./TMVAClassificationApplication ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} ${weights_file} ${nevts}
-      mv TMVApp.root ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/$${syst}/{file}
-      echo 'moving output to ' ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file}
+      echo ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} >> ${manifest}
     done
   done
   
@@ -122,10 +121,7 @@ for channel in el mu
     do
     for file in `ls -1 ${input_path}/${channel}/${syst}`
       do
-      echo 'running over ' ${input_path}/${channel}/${syst}/${file}
-      ./TMVAClassificationApplication ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} ${weights_file} ${nevts}
-      mv TMVApp.root ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/$${syst}/{file}
-      echo 'moving output to ' ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file}
+      echo ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} >> ${manifest}
     done
   done
 done 
@@ -136,10 +132,7 @@ for channel in el
     do 
     for file in diboson.root singletop.root tprime_500.root tprime_550.root tprime_600.root tprime_650.root tprime_700.root tprime_750.root ttbar.root wjets.root zjets.root  
       do 
-      echo 'running over ' ${input_path}/${channel}/${syst}/${file}
-      ./TMVAClassificationApplication ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} ${weights_file} ${nevts}
-      mv TMVApp.root ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/$${syst}/{file}
-      echo 'moving output to ' ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file}
+      echo ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} >> ${manifest}
     done 
   done
 done
@@ -150,10 +143,10 @@ for channel in mu
     do
     for file in diboson.root singletop.root tprime_500.root tprime_550.root tprime_600.root tprime_650.root tprime_700.root tprime_750.root ttbar.root wjets.root zjets.root 
       do
-      echo 'running over ' ${input_path}/${channel}/${syst}/${file}
-      ./TMVAClassificationApplication ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} ${weights_file} ${nevts}
-      mv TMVApp.root ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/$${syst}/{file}
-      echo 'moving output to ' ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file}
+      echo ${input_path}/${channel}/${syst}/${file} ${output_path}/${channel}/${analysis_channel}/${btconf#*_}/${syst}/${file} >> ${manifest}
     done
   done
 done
+
+echo 'applying to ' `wc -l < ${manifest}` ' files of ' ${manifest}
+./TMVAClassificationApplication -c ${score_cache} -m ${manifest} ${weights_file} ${nevts:--1} ${nworkers}